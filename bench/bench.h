@@ -0,0 +1,25 @@
+#pragma once
+
+// Benchmarks for relay module, built as separate executable with logging disabled
+
+#include "types.h"
+
+typedef void (*BENCH_func_T)(void);
+
+/*********************************************************************************************************
+ * @brief Retrieve monotonic time in seconds, used for measuring benchmark duration.
+ *********************************************************************************************************
+ * @param [in] Nothing.
+ * @return Monotonic time in seconds.
+ ********************************************************************************************************/
+double BENCH_now(void);
+
+void BENCH_contention(void);
+void BENCH_sweep(void);
+void BENCH_scale(void);
+void BENCH_dispatch(void);
+void BENCH_trace(void);
+void BENCH_clock(void);
+void BENCH_faults(void);
+void BENCH_boards(void);
+void BENCH_timers(void);
@@ -0,0 +1,154 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "mdl_relay.h"
+
+// Gateway supervising several boards: each board is own instance (RELAY_ctx_T) with loopback I/O,
+// driven by own thread switching all relays and sweeping them, serially or on own worker pool.
+// Instances share no state, so throughput should grow with boards up to number of cores.
+
+// clang-format off
+enum { RELAYS_NUMBER = 4U * RELAY_SHARD_SIZE, PASSES = 10000U, MAX_BOARDS = 8U, WORKERS = 2U };
+// clang-format on
+
+// Board whose feedback lines follow its outputs at once and report their changes
+typedef struct board
+{
+    pthread_t ptid;
+    RELAY_ctx_T* ctx;
+    void* memory;
+    void* storage;
+    RELAY_config_T config[RELAYS_NUMBER];
+    DO_mask_T outputs[DO_PORTS_NUMBER];
+    DO_mask_T changes[DO_PORTS_NUMBER];
+} board_T;
+
+static DI_mask_T get_inputs(void* arg, uint32_t port)
+{
+    board_T* board = arg;
+
+    return port < DO_PORTS_NUMBER ? ATOMIC_LOAD(board->outputs[port]) : 0;
+}
+
+static void set_outputs(void* arg, uint32_t port, DO_mask_T mask, DO_mask_T states)
+{
+    board_T* board = arg;
+    DO_mask_T outputs = ATOMIC_LOAD(board->outputs[port]);
+
+    ATOMIC_STORE(board->outputs[port], (outputs & ~mask) | (states & mask));
+    ATOMIC_OR(board->changes[port], (outputs ^ states) & mask);
+}
+
+static DI_mask_T get_changes(void* arg, uint32_t port)
+{
+    board_T* board = arg;
+
+    return port < DO_PORTS_NUMBER ? ATOMIC_EXCHANGE(board->changes[port], 0) : 0;
+}
+
+static void* drive(void* arg)
+{
+    board_T* board = arg;
+    uint32_t relay_ids[RELAYS_NUMBER];
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        relay_ids[i] = i;
+    }
+
+    for (uint32_t i = 0; i < PASSES; ++i)
+    {
+        if (i % 4u == 0)
+        {
+            if (i & 4u)
+                RELAY_ctx_open_many(board->ctx, relay_ids, RELAYS_NUMBER);
+            else
+                RELAY_ctx_close_many(board->ctx, relay_ids, RELAYS_NUMBER);
+        }
+
+        RELAY_ctx_routine(board->ctx);
+    }
+
+    return NULL;
+}
+
+static void create_board(board_T* board, uint32_t workers)
+{
+    RELAY_hal_T hal = {get_inputs, set_outputs, get_changes, NULL, NULL, board};
+    size_t storage_size = RELAY_get_storage_size(RELAYS_NUMBER);
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        board->config[i] = (RELAY_config_T){RELAY_type_NO,
+                                            (DO_index_E)(i % DO_index_NUMBER),
+                                            (DI_index_E)(i % DI_index_NUMBER),
+                                            0u};
+    }
+
+    for (uint32_t port = 0; port < DO_PORTS_NUMBER; ++port)
+    {
+        board->outputs[port] = 0;
+        board->changes[port] = 0;
+    }
+
+    board->memory = malloc(RELAY_ctx_get_size());
+    board->storage = malloc(storage_size);
+    board->ctx = RELAY_ctx_create(board->memory, RELAY_ctx_get_size(), &hal);
+
+    RELAY_ctx_init(board->ctx, board->config, RELAYS_NUMBER, board->storage, storage_size);
+    RELAY_ctx_set_event_pump(board->ctx, true);
+    RELAY_ctx_set_workers(board->ctx, workers);
+}
+
+static void destroy_board(board_T* board)
+{
+    RELAY_ctx_deinit(board->ctx);
+    free(board->storage);
+    free(board->memory);
+}
+
+static double run(board_T* boards, uint32_t number, uint32_t workers)
+{
+    for (uint32_t i = 0; i < number; ++i)
+    {
+        create_board(&boards[i], workers);
+    }
+
+    double start = BENCH_now();
+
+    for (uint32_t i = 0; i < number; ++i)
+    {
+        pthread_create(&boards[i].ptid, NULL, drive, &boards[i]);
+    }
+
+    for (uint32_t i = 0; i < number; ++i)
+    {
+        pthread_join(boards[i].ptid, NULL);
+    }
+
+    double elapsed = BENCH_now() - start;
+
+    for (uint32_t i = 0; i < number; ++i)
+    {
+        destroy_board(&boards[i]);
+    }
+
+    return number * PASSES / elapsed;
+}
+
+void BENCH_boards(void)
+{
+    static board_T boards[MAX_BOARDS];
+
+    printf("%8s %8s %16s\n", "boards", "workers", "passes/s");
+
+    for (uint32_t workers = 0; workers <= WORKERS; workers += WORKERS)
+    {
+        for (uint32_t number = 1; number <= MAX_BOARDS; number *= 2)
+        {
+            printf("%8u %8u %16.0f\n", number, workers, run(boards, number, workers));
+        }
+    }
+}
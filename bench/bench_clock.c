@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "bench.h"
+#include "mdl_clock.h"
+
+// Cost of CLOCK_getTicks() call, it is read by each transition step, compared with raw system
+// clocks it may be built on
+
+// clang-format off
+enum { CALLS = 2000000U };
+// clang-format on
+
+static volatile CLOCK_ticks_T m_sink;
+
+static void run_ticks(const char* name)
+{
+    double start = BENCH_now();
+
+    for (uint32_t i = 0; i < CALLS; ++i)
+    {
+        m_sink = CLOCK_getTicks();
+    }
+
+    printf("%24s %12.1f\n", name, (BENCH_now() - start) * 1e9 / CALLS);
+}
+
+static void run_clock(const char* name, clockid_t clock_id)
+{
+    struct timespec ts;
+    double start = BENCH_now();
+
+    for (uint32_t i = 0; i < CALLS; ++i)
+    {
+        clock_gettime(clock_id, &ts);
+        m_sink = (CLOCK_ticks_T)ts.tv_nsec;
+    }
+
+    printf("%24s %12.1f\n", name, (BENCH_now() - start) * 1e9 / CALLS);
+}
+
+void BENCH_clock(void)
+{
+    printf("ticks per ms: %u\n", CLOCK_TICKS_PER_MS);
+    printf("%24s %12s\n", "clock", "ns/call");
+
+    CLOCK_setSource(CLOCK_source_MONOTONIC);
+    run_ticks("CLOCK_getTicks");
+    run_clock("CLOCK_MONOTONIC", CLOCK_MONOTONIC);
+#ifdef CLOCK_MONOTONIC_COARSE
+    run_clock("CLOCK_MONOTONIC_COARSE", CLOCK_MONOTONIC_COARSE);
+#endif
+
+    CLOCK_setSource(CLOCK_source_VIRTUAL);
+    run_ticks("CLOCK_getTicks virtual");
+    CLOCK_setSource(CLOCK_source_MONOTONIC);
+}
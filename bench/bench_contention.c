@@ -0,0 +1,97 @@
+#include <pthread.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "mdl_relay.h"
+#include "simu.h"
+
+// Throughput of RELAY_open()/RELAY_close()/RELAY_get_state() issued by several control threads,
+// each thread drives own relay on own DO and DI pins while supervision thread sweeps
+// RELAY_routine() without pause.
+
+// clang-format off
+enum { RELAYS_NUMBER = 16U, OPS_PER_THREAD = 200000U, MAX_THREADS = 8U };
+// clang-format on
+
+typedef struct worker
+{
+    pthread_t ptid;
+    uint32_t relay_id;
+} worker_T;
+
+static volatile bool m_stop;
+
+static void* control(void* arg)
+{
+    worker_T* w = arg;
+
+    for (uint32_t i = 0; i < OPS_PER_THREAD; ++i)
+    {
+        if (i & 1u)
+            RELAY_open(w->relay_id);
+        else
+            RELAY_close(w->relay_id);
+
+        (void)RELAY_get_state(w->relay_id);
+    }
+
+    return NULL;
+}
+
+static void* supervision(void* arg)
+{
+    (void)arg;
+
+    while (!m_stop)
+    {
+        RELAY_routine();
+    }
+
+    return NULL;
+}
+
+void BENCH_contention(void)
+{
+    RELAY_config_T config[RELAYS_NUMBER];
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        config[i] = (RELAY_config_T){RELAY_type_NO, (DO_index_E)i, (DI_index_E)i, 1u};
+    }
+
+    SIMU_init(SIMU_mode_CORRECT, config, RELAYS_NUMBER);
+    RELAY_init(config, RELAYS_NUMBER);
+
+    printf("%8s %16s\n", "threads", "ops/s");
+
+    for (uint32_t threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        worker_T workers[MAX_THREADS];
+        pthread_t supervisor;
+
+        m_stop = false;
+        pthread_create(&supervisor, NULL, supervision, NULL);
+
+        double start = BENCH_now();
+
+        for (uint32_t i = 0; i < threads; ++i)
+        {
+            workers[i].relay_id = i;
+            pthread_create(&workers[i].ptid, NULL, control, &workers[i]);
+        }
+
+        for (uint32_t i = 0; i < threads; ++i)
+        {
+            pthread_join(workers[i].ptid, NULL);
+        }
+
+        double elapsed = BENCH_now() - start;
+
+        m_stop = true;
+        pthread_join(supervisor, NULL);
+
+        printf("%8u %16.0f\n", threads, 2.0 * threads * OPS_PER_THREAD / elapsed);
+    }
+
+    RELAY_deinit();
+}
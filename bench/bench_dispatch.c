@@ -0,0 +1,143 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "mdl_relay.h"
+#include "simu.h"
+
+// Latency of state notification delivery, from start of RELAY_routine() pass giving switching
+// verdict till listener call: delivered by RELAY_routine() itself and by dispatcher thread pumping
+// RELAY_dispatch_events().
+
+// clang-format off
+enum { RELAYS_NUMBER = 16U, ROUNDS = 2000U, SAMPLES = RELAYS_NUMBER * ROUNDS };
+// clang-format on
+
+static volatile bool m_stop;
+static volatile double m_pass_start;
+static double m_samples[SAMPLES];
+static uint32_t m_delivered;
+
+static void on_state(uint32_t relay_id, RELAY_state_E state)
+{
+    (void)relay_id;
+    (void)state;
+
+    uint32_t n = __atomic_load_n(&m_delivered, __ATOMIC_RELAXED);
+
+    if (n < SAMPLES) m_samples[n] = BENCH_now() - m_pass_start;
+
+    __atomic_store_n(&m_delivered, n + 1u, __ATOMIC_RELEASE);
+}
+
+static void* dispatcher(void* arg)
+{
+    (void)arg;
+
+    while (!m_stop)
+    {
+        if (RELAY_dispatch_events(RELAY_EVENT_QUEUE_SIZE) == 0) sched_yield();
+    }
+
+    return NULL;
+}
+
+static int compare(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+static void run(const char* mode, bool pump)
+{
+    uint32_t relay_ids[RELAYS_NUMBER];
+    RELAY_queue_stats_T stats;
+    pthread_t ptid;
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        relay_ids[i] = i;
+    }
+
+    RELAY_set_event_pump(pump);
+
+    m_stop = false;
+    if (pump) pthread_create(&ptid, NULL, dispatcher, NULL);
+
+    // notifications of initial states and previous run are not measured
+    RELAY_get_event_stats(&stats);
+    __atomic_store_n(&m_delivered, 0u, __ATOMIC_RELEASE);
+    uint32_t base = stats.accepted;
+
+    for (uint32_t round = 0; round < ROUNDS; ++round)
+    {
+        if (round & 1u)
+            RELAY_open_many(relay_ids, RELAYS_NUMBER);
+        else
+            RELAY_close_many(relay_ids, RELAYS_NUMBER);
+
+        // pass by pass, each pass waits for delivery of notifications it has queued
+        while (__atomic_load_n(&m_delivered, __ATOMIC_ACQUIRE) < (round + 1u) * RELAYS_NUMBER)
+        {
+            m_pass_start = BENCH_now();
+            RELAY_routine();
+
+            RELAY_get_event_stats(&stats);
+            while (__atomic_load_n(&m_delivered, __ATOMIC_ACQUIRE) < stats.accepted - base)
+            {
+                sched_yield();
+            }
+        }
+    }
+
+    m_stop = true;
+    if (pump) pthread_join(ptid, NULL);
+
+    qsort(m_samples, SAMPLES, sizeof(double), compare);
+
+    double sum = 0;
+    for (uint32_t i = 0; i < SAMPLES; ++i)
+    {
+        sum += m_samples[i];
+    }
+
+    printf(
+        "%8s %8u %12.2f %12.2f %12.2f\n",
+        mode,
+        SAMPLES,
+        sum * 1e6 / SAMPLES,
+        m_samples[SAMPLES * 99u / 100u] * 1e6,
+        m_samples[SAMPLES - 1u] * 1e6);
+}
+
+void BENCH_dispatch(void)
+{
+    RELAY_config_T config[RELAYS_NUMBER];
+    RELAY_listener_id_T listener_id;
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        DO_index_E control = (DO_index_E)(i % DO_index_NUMBER);
+
+        config[i] = (RELAY_config_T){RELAY_type_NO, control, (DI_index_E)RELAY_WO_FEEDBACK, 0u};
+    }
+
+    SIMU_init(SIMU_mode_CORRECT, config, RELAYS_NUMBER);
+    RELAY_init(config, RELAYS_NUMBER);
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        RELAY_add_state_listener(i, on_state, &listener_id);
+    }
+
+    printf("%8s %8s %12s %12s %12s\n", "mode", "events", "avg us", "p99 us", "max us");
+
+    run("routine", false);
+    run("pump", true);
+
+    RELAY_set_event_pump(false);
+    RELAY_deinit();
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "mdl_clock.h"
+#include "mdl_relay.h"
+#include "simu.h"
+
+// Supervision of large relay bank on virtual clock with stochastic faults: cost of RELAY_routine()
+// per relay while all relays are switched back and forth, and fault detection latency, from time
+// simulated contacts should have settled till error is reported.
+
+// clang-format off
+enum {
+    RELAYS_NUMBER = DO_index_NUMBER < (int)DI_index_NUMBER ? DO_index_NUMBER : DI_index_NUMBER,
+    ROUNDS = 200U,
+    RESPONSE_MS = 20U,
+    PERIOD_MS = 25U, // between switchings, response time and some stable state
+};
+// clang-format on
+
+static double m_latencies[RELAYS_NUMBER];
+
+static int compare(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+// Look for relays in error since last call, return number of errors without simulated fault
+static uint32_t collect_errors(bool* failed, uint32_t* detected)
+{
+    uint32_t false_positives = 0;
+    CLOCK_ticks_T now = CLOCK_getTicks();
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (failed[i] || RELAY_get_error(i) == RELAY_error_NO) continue;
+
+        SIMU_fault_T fault;
+
+        failed[i] = true;
+        SIMU_get_fault(i, &fault);
+
+        if (fault.type == SIMU_fault_NO)
+        {
+            ++false_positives;
+            continue;
+        }
+
+        m_latencies[(*detected)++] = (double)(now - fault.since) / CLOCK_TICKS_PER_MS;
+    }
+
+    return false_positives;
+}
+
+void BENCH_faults(void)
+{
+    RELAY_config_T* config = malloc(sizeof(RELAY_config_T) * RELAYS_NUMBER);
+    size_t storage_size = RELAY_get_storage_size(RELAYS_NUMBER);
+    void* storage = malloc(storage_size);
+    uint32_t* relay_ids = malloc(sizeof(uint32_t) * RELAYS_NUMBER);
+    bool* failed = calloc(RELAYS_NUMBER, sizeof(bool));
+    const SIMU_model_T model = {SIMU_delay_UNIFORM, 8u, 4u, 3u, 1000u, 1000u};
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        config[i] = (RELAY_config_T){RELAY_type_NO, (DO_index_E)i, (DI_index_E)i, RESPONSE_MS};
+        relay_ids[i] = i;
+    }
+
+    CLOCK_setSource(CLOCK_source_VIRTUAL);
+    SIMU_set_seed(1u);
+    SIMU_init(SIMU_mode_CORRECT, config, RELAYS_NUMBER);
+    RELAY_init_with_storage(config, RELAYS_NUMBER, storage, storage_size);
+    RELAY_set_change_checks(true);
+    RELAY_set_event_pump(true);
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        SIMU_set_model(i, &model);
+    }
+
+    uint32_t passes = 0, detected = 0, false_positives = 0;
+    double elapsed = 0;
+
+    // last rounds have no switching, so faults of last actuation are detected too
+    for (uint32_t round = 0; round < ROUNDS + 2u; ++round)
+    {
+        if (round < ROUNDS)
+        {
+            if (round & 1u)
+                RELAY_open_many(relay_ids, RELAYS_NUMBER);
+            else
+                RELAY_close_many(relay_ids, RELAYS_NUMBER);
+        }
+
+        for (uint32_t t = 0; t < PERIOD_MS; ++t)
+        {
+            CLOCK_advance(CLOCK_MS_TO_TICKS(1u));
+
+            SIMU_routine();
+
+            double start = BENCH_now();
+            RELAY_routine();
+            elapsed += BENCH_now() - start;
+            ++passes;
+
+            while (RELAY_dispatch_events(RELAY_EVENT_QUEUE_SIZE) != 0)
+            {
+            }
+
+            false_positives += collect_errors(failed, &detected);
+        }
+    }
+
+    SIMU_stats_T stats;
+    SIMU_get_stats(&stats);
+
+    RELAY_deinit();
+    CLOCK_setSource(CLOCK_source_MONOTONIC);
+
+    printf("%8s %12s %10s %10s %10s %10s\n",
+           "relays", "ns/relay", "actuations", "faults", "detected", "false");
+    printf("%8u %12.2f %10u %10u %10u %10u\n",
+           (uint32_t)RELAYS_NUMBER,
+           elapsed * 1e9 / ((double)passes * RELAYS_NUMBER),
+           stats.actuations,
+           stats.welds + stats.stuck_opens,
+           detected,
+           false_positives);
+
+    if (detected != 0)
+    {
+        qsort(m_latencies, detected, sizeof(double), compare);
+
+        printf("%8s %10s %10s %10s\n", "latency", "p50 ms", "p99 ms", "max ms");
+        printf("%8s %10.1f %10.1f %10.1f\n",
+               "",
+               m_latencies[detected / 2u],
+               m_latencies[(uint32_t)(detected * 0.99)],
+               m_latencies[detected - 1u]);
+    }
+
+    free(failed);
+    free(relay_ids);
+    free(storage);
+    free(config);
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "mdl_clock.h"
+#include "mdl_relay.h"
+#include "simu.h"
+
+// Cost of RELAY_routine() per relay for relay tables beyond MAX_SUPPORTED_RELAYS_NUMBER, placed
+// in caller storage. Relays share feedback lines, as there are only DI_index_NUMBER of them. Bank
+// is measured open and then closed, so feedback of closed relays is checked too. Virtual clock is
+// moved by self check period per pass, so each pass checks all stable relays.
+
+// clang-format off
+enum { STEPS = 5000000U, SETTLE_MS = 100U };
+// clang-format on
+
+static const uint32_t m_sizes[] = {10u, 1000u, 100000u};
+
+static double measure(uint32_t relays_number)
+{
+    uint32_t passes = STEPS / relays_number;
+    double start = BENCH_now();
+
+    for (uint32_t i = 0; i < passes; ++i)
+    {
+        CLOCK_advance(CLOCK_MS_TO_TICKS(RELAY_SELF_CHECK_PERIOD_MS));
+        RELAY_routine();
+    }
+
+    return (BENCH_now() - start) * 1e9 / ((double)passes * relays_number);
+}
+
+static uint32_t close_all(uint32_t relays_number)
+{
+    uint32_t closed = 0;
+
+    for (uint32_t i = 0; i < relays_number; ++i)
+    {
+        RELAY_close(i);
+    }
+
+    // state notifications are dispatched by one event queue per pass
+    uint32_t passes = SETTLE_MS + relays_number / RELAY_EVENT_QUEUE_SIZE;
+
+    for (uint32_t i = 0; i < passes; ++i)
+    {
+        CLOCK_advance(CLOCK_MS_TO_TICKS(1u));
+        RELAY_routine();
+    }
+
+    for (uint32_t i = 0; i < relays_number; ++i)
+    {
+        if (RELAY_get_state(i) == RELAY_state_CLOSE) ++closed;
+    }
+
+    return closed;
+}
+
+void BENCH_scale(void)
+{
+    CLOCK_setSource(CLOCK_source_VIRTUAL);
+
+    printf("%8s %8s %12s %16s\n", "relays", "closed", "bytes/relay", "ns/relay");
+
+    for (size_t s = 0; s < sizeof(m_sizes) / sizeof(m_sizes[0]); ++s)
+    {
+        uint32_t relays_number = m_sizes[s];
+        RELAY_config_T* config = malloc(sizeof(RELAY_config_T) * relays_number);
+        size_t storage_size = RELAY_get_storage_size(relays_number);
+        size_t bytes = storage_size / relays_number + sizeof(RELAY_config_T);
+        void* storage = malloc(storage_size);
+
+        for (uint32_t i = 0; i < relays_number; ++i)
+        {
+            DO_index_E control = (DO_index_E)(i % DO_index_NUMBER);
+            DI_index_E feedback = (DI_index_E)(i % DI_index_NUMBER);
+
+            config[i] = (RELAY_config_T){RELAY_type_NO, control, feedback, 1u};
+        }
+
+        SIMU_init(SIMU_mode_CORRECT, config, relays_number);
+        RELAY_init_with_storage(config, relays_number, storage, storage_size);
+
+        printf("%8u %8u %12zu %16.2f\n", relays_number, 0u, bytes, measure(relays_number));
+
+        uint32_t closed = close_all(relays_number);
+
+        printf("%8u %8u %12zu %16.2f\n", relays_number, closed, bytes, measure(relays_number));
+
+        RELAY_deinit();
+        free(storage);
+        free(config);
+    }
+
+    CLOCK_setSource(CLOCK_source_MONOTONIC);
+}
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "mdl_clock.h"
+#include "mdl_relay.h"
+#include "simu.h"
+
+// Duration of RELAY_routine() pass over relay bank, serial and sharded on worker pool. Relays are
+// in caller storage to get many shards, first quarter of shards has all relays switching, the
+// rest are stable, so contiguous task ranges are uneven and idle workers steal. Virtual clock is
+// kept still, so transitions stay in flight for all passes.
+
+// clang-format off
+enum { PASSES_RELAYS = 2000000U, MAX_WORKERS = 4U, HOT_SHARDS_DIVIDER = 4U };
+// clang-format on
+
+static const uint32_t m_sizes[] = {RELAY_SHARD_SIZE, 16384u};
+
+void BENCH_sweep(void)
+{
+    CLOCK_setSource(CLOCK_source_VIRTUAL);
+
+    printf("%8s %8s %10s %8s %16s\n", "relays", "shards", "switching", "workers", "ns/pass");
+
+    for (size_t s = 0; s < sizeof(m_sizes) / sizeof(m_sizes[0]); ++s)
+    {
+        uint32_t relays_number = m_sizes[s];
+        uint32_t shards = (relays_number + RELAY_SHARD_SIZE - 1u) / RELAY_SHARD_SIZE;
+        uint32_t hot_shards = (shards + HOT_SHARDS_DIVIDER - 1u) / HOT_SHARDS_DIVIDER;
+        uint32_t switching = 0;
+        RELAY_config_T* config = malloc(sizeof(RELAY_config_T) * relays_number);
+        size_t storage_size = RELAY_get_storage_size(relays_number);
+        void* storage = malloc(storage_size);
+
+        for (uint32_t i = 0; i < relays_number; ++i)
+        {
+            DO_index_E control = (DO_index_E)(i % DO_index_NUMBER);
+            DI_index_E feedback = (DI_index_E)(i % DI_index_NUMBER);
+
+            config[i] = (RELAY_config_T){RELAY_type_NO, control, feedback, 1000u};
+        }
+
+        SIMU_init(SIMU_mode_CORRECT, config, relays_number);
+        RELAY_init_with_storage(config, relays_number, storage, storage_size);
+
+        for (uint32_t i = 0; i < relays_number && i / RELAY_SHARD_SIZE < hot_shards; ++i)
+        {
+            if (RELAY_close(i) == RELAY_command_APPLIED) ++switching;
+        }
+
+        uint32_t passes = PASSES_RELAYS / relays_number;
+
+        for (uint32_t workers = 0; workers <= MAX_WORKERS; workers = workers ? workers * 2 : 1)
+        {
+            RELAY_set_workers(workers);
+
+            double start = BENCH_now();
+
+            for (uint32_t i = 0; i < passes; ++i)
+            {
+                RELAY_routine();
+            }
+
+            double elapsed = BENCH_now() - start;
+
+            printf(
+                "%8u %8u %10u %8u %16.0f\n",
+                relays_number,
+                shards,
+                switching,
+                workers,
+                elapsed * 1e9 / passes);
+        }
+
+        RELAY_set_workers(0);
+        RELAY_deinit();
+        free(storage);
+        free(config);
+    }
+
+    CLOCK_setSource(CLOCK_source_MONOTONIC);
+}
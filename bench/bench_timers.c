@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "mdl_relay.h"
+#include "simu.h"
+
+// Scheduled commands of relay bank on virtual clock: cost of scheduling and cancelling one, cost
+// of RELAY_routine() per fired timer, and firing accuracy, timers fired later or earlier than
+// their tick, with RELAY_TIMERS_NUMBER timers pending at once
+
+// clang-format off
+enum { RELAYS_NUMBER = 64U, TIMERS = RELAY_TIMERS_NUMBER, SPAN_MS = 60000U };
+// clang-format on
+
+static CLOCK_ticks_T m_ticks[TIMERS];
+static RELAY_timer_id_T m_timer_ids[TIMERS];
+static uint32_t m_due[SPAN_MS + 1u]; // timers due per ms
+
+static int compare(const void* a, const void* b)
+{
+    CLOCK_ticks_T x = *(const CLOCK_ticks_T*)a, y = *(const CLOCK_ticks_T*)b;
+
+    return (x > y) - (x < y);
+}
+
+void BENCH_timers(void)
+{
+    RELAY_config_T config[RELAYS_NUMBER];
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        DO_index_E control = (DO_index_E)(i % DO_index_NUMBER);
+
+        config[i] = (RELAY_config_T){RELAY_type_NO, control, (DI_index_E)RELAY_WO_FEEDBACK, 5u};
+    }
+
+    CLOCK_setSource(CLOCK_source_VIRTUAL);
+    SIMU_init(SIMU_mode_CORRECT, config, RELAYS_NUMBER);
+    RELAY_init(config, RELAYS_NUMBER);
+
+    srand(1u);
+    CLOCK_ticks_T start = CLOCK_getTicks();
+
+    for (uint32_t i = 0; i < TIMERS; ++i)
+    {
+        m_ticks[i] = start + CLOCK_MS_TO_TICKS(1u + (uint32_t)rand() % SPAN_MS);
+    }
+
+    // schedule all, cancel every other one and schedule it again
+    double t0 = BENCH_now();
+    for (uint32_t i = 0; i < TIMERS; ++i)
+    {
+        if (i & 1u)
+            RELAY_close_at(i % RELAYS_NUMBER, m_ticks[i], &m_timer_ids[i]);
+        else
+            RELAY_open_at(i % RELAYS_NUMBER, m_ticks[i], &m_timer_ids[i]);
+    }
+    double t1 = BENCH_now();
+    for (uint32_t i = 0; i < TIMERS; i += 2u)
+    {
+        RELAY_cancel_timer(m_timer_ids[i]);
+    }
+    double t2 = BENCH_now();
+    for (uint32_t i = 0; i < TIMERS; i += 2u)
+    {
+        RELAY_open_at(i % RELAYS_NUMBER, m_ticks[i], &m_timer_ids[i]);
+    }
+
+    uint32_t pending = RELAY_get_pending_timers();
+
+    qsort(m_ticks, TIMERS, sizeof(CLOCK_ticks_T), compare);
+    for (uint32_t i = 0; i < TIMERS; ++i)
+    {
+        ++m_due[CLOCK_TICKS_TO_MS(m_ticks[i] - start)];
+    }
+
+    // pass per ms, timers due at its tick should be fired by it, none of later ones
+    uint32_t fired = 0, missed = 0;
+    double routine = 0;
+
+    for (uint32_t ms = 1u; ms <= SPAN_MS; ++ms)
+    {
+        CLOCK_advance(CLOCK_MS_TO_TICKS(1u));
+
+        double t = BENCH_now();
+        RELAY_routine();
+        routine += BENCH_now() - t;
+
+        fired += m_due[ms];
+        if (RELAY_get_pending_timers() != pending - fired) ++missed;
+    }
+
+    printf("%10s %10s %12s %12s %14s %10s\n",
+           "timers",
+           "fired",
+           "add ns",
+           "cancel ns",
+           "pass us",
+           "missed");
+    printf("%10u %10u %12.1f %12.1f %14.3f %10u\n",
+           pending,
+           fired,
+           (t1 - t0) * 1e9 / TIMERS,
+           (t2 - t1) * 1e9 / (TIMERS / 2u),
+           routine * 1e6 / SPAN_MS,
+           missed);
+
+    RELAY_deinit();
+    CLOCK_setSource(CLOCK_source_MONOTONIC);
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "trace.h"
+
+// Cost of one log record of state function shape: printf based logging versus binary trace
+// record, and its deferred decoding by TRACE_flush()
+
+// clang-format off
+enum { RECORDS = 200000U };
+// clang-format on
+
+void BENCH_trace(void)
+{
+    FILE* null = fopen("/dev/null", "w");
+
+    if (null == NULL) return;
+
+    printf("%8s %16s\n", "backend", "ns/record");
+
+    double start = BENCH_now();
+
+    for (uint32_t i = 0; i < RECORDS; ++i)
+    {
+        fprintf(null, "%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, i, 2, 0);
+        fprintf(null, "\n");
+    }
+
+    printf("%8s %16.1f\n", "printf", (BENCH_now() - start) * 1e9 / RECORDS);
+
+    // ring is flushed when full, so only writes are timed
+    double write = 0, flush = 0;
+
+    for (uint32_t i = 0; i < RECORDS; i += TRACE_RING_SIZE)
+    {
+        start = BENCH_now();
+
+        for (uint32_t j = 0; j < TRACE_RING_SIZE; ++j)
+        {
+            TRACE(TRACE_LEVEL_DEBUG, "%s(relay_id: %d, event: %d): %d",
+                  __PRETTY_FUNCTION__, i + j, 2, 0);
+        }
+
+        double flush_start = BENCH_now();
+        write += flush_start - start;
+
+        TRACE_flush(null);
+        flush += BENCH_now() - flush_start;
+    }
+
+    uint32_t records = (RECORDS + TRACE_RING_SIZE - 1u) / TRACE_RING_SIZE * TRACE_RING_SIZE;
+
+    printf("%8s %16.1f\n", "trace", write * 1e9 / records);
+    printf("%8s %16.1f\n", "decode", flush * 1e9 / records);
+
+    fclose(null);
+}
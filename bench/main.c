@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+typedef struct bench
+{
+    const char* name;
+    BENCH_func_T func;
+} bench_T;
+
+static bench_T m_benches[] = {
+    {"contention", BENCH_contention},
+    {"sweep", BENCH_sweep},
+    {"scale", BENCH_scale},
+    {"dispatch", BENCH_dispatch},
+    {"trace", BENCH_trace},
+    {"clock", BENCH_clock},
+    {"faults", BENCH_faults},
+    {"boards", BENCH_boards},
+    {"timers", BENCH_timers},
+};
+
+static const size_t m_benches_size = sizeof(m_benches) / sizeof(bench_T);
+
+int main(int argc, char* argv[])
+{
+    const char* name = argc > 1 ? argv[1] : NULL;
+
+    for (size_t i = 0; i < m_benches_size; ++i)
+    {
+        if (name && strcmp(name, m_benches[i].name) != 0) continue;
+
+        printf("=== %s\n", m_benches[i].name);
+        m_benches[i].func();
+        fflush(stdout);
+    }
+
+    return 0;
+}
+
+double BENCH_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
@@ -1,11 +1,60 @@
+#pragma once
+
 #include "types.h"
 
-typedef uint32_t CLOCK_ticks_T;
+// Ticks are 64 bits wide, so they don't overflow in system life time, still deadlines are compared
+// by CLOCK_IS_DUE() which stays correct across wrap
+typedef uint64_t CLOCK_ticks_T;
+
+// Tick resolution, 1 - millisecond ticks, 1000 - microsecond ones. Should divide 1000000.
+#ifndef CLOCK_TICKS_PER_MS
+#define CLOCK_TICKS_PER_MS 1u
+#endif
+
+#define CLOCK_NS_PER_TICK (1000000u / CLOCK_TICKS_PER_MS)
+#define CLOCK_MS_TO_TICKS(ms) ((CLOCK_ticks_T)(ms) * CLOCK_TICKS_PER_MS)
+#define CLOCK_TICKS_TO_MS(ticks) (((ticks) + CLOCK_TICKS_PER_MS - 1u) / CLOCK_TICKS_PER_MS) // ceil
+
+// true when deadline is reached at now
+#define CLOCK_IS_DUE(deadline, now) \
+    ((long long)((CLOCK_ticks_T)(now) - (CLOCK_ticks_T)(deadline)) >= 0)
+
+// Time source of CLOCK_getTicks(): monotonic system clock, or virtual clock which stays still till
+// it is advanced explicitly, e.g. by simulation to run faster than real time and reproducibly
+typedef enum CLOCK_source_ENUM
+{
+    CLOCK_source_MONOTONIC,
+    CLOCK_source_VIRTUAL,
+} CLOCK_source_E;
 
 /*********************************************************************************************************
- * @brief Retrieve elapsed miliseconds from power-up. Assume there will be no overflow.
+ * @brief Retrieve elapsed ticks from power-up.
  *********************************************************************************************************
  * @param [in] Nothing.
  * @return Number of ticks elapsed.
  ********************************************************************************************************/
 CLOCK_ticks_T CLOCK_getTicks();
+
+/*********************************************************************************************************
+ * @brief Select time source, virtual clock starts from 0 on each selection.
+ *********************************************************************************************************
+ * @param [in] source - Time source.
+ * @return Nothing.
+ ********************************************************************************************************/
+void CLOCK_setSource(CLOCK_source_E source);
+
+/*********************************************************************************************************
+ * @brief Retrieve selected time source.
+ *********************************************************************************************************
+ * @param [in] Nothing.
+ * @return Time source.
+ ********************************************************************************************************/
+CLOCK_source_E CLOCK_getSource(void);
+
+/*********************************************************************************************************
+ * @brief Advance virtual clock, ignored for monotonic one.
+ *********************************************************************************************************
+ * @param [in] ticks - Number of ticks to advance.
+ * @return Nothing.
+ ********************************************************************************************************/
+void CLOCK_advance(CLOCK_ticks_T ticks);
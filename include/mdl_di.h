@@ -1,5 +1,12 @@
 #pragma once
 
+#include "types.h"
+
+// Number of DI pins on board, simulation of large relay banks may extend it beyond named indexes
+#ifndef DI_PINS_NUMBER
+#define DI_PINS_NUMBER 16u
+#endif
+
 //! Digital Input (DI) indexes
 typedef enum DI_index_ENUM
 {
@@ -19,7 +26,7 @@ typedef enum DI_index_ENUM
     DI_index_13 = 13u, //!< Index of DI pin 13
     DI_index_14 = 14u, //!< Index of DI pin 14
     DI_index_15 = 15u, //!< Index of DI pin 15
-    DI_index_NUMBER = 16u //!< Number of DI indexes
+    DI_index_NUMBER = DI_PINS_NUMBER //!< Number of DI indexes
 } DI_index_E;
 
 //! Digital Input (DI) states
@@ -30,6 +37,15 @@ typedef enum DI_state_ENUM
     DI_state_NUMBER = 2u, //!< Number of digital input states
 } DI_state_E;
 
+//! Digital inputs are grouped in ports read at once, bit n of port p is DI pin p * DI_PORT_WIDTH + n
+typedef uint32_t DI_mask_T;
+
+enum
+{
+    DI_PORT_WIDTH = 32u, //!< Number of DI pins in port
+    DI_PORTS_NUMBER = (DI_index_NUMBER + DI_PORT_WIDTH - 1u) / DI_PORT_WIDTH //!< Number of DI ports
+};
+
 /********************************************************************************************************
  * @details Function returns digital input state based on index value.
  *********************************************************************************************************
@@ -37,3 +53,44 @@ typedef enum DI_state_ENUM
  * @return Digital input state see ::DI_state_ENUM.
  ********************************************************************************************************/
 DI_state_E DI_getInputState(DI_index_E index);
+
+/********************************************************************************************************
+ * @details Function returns states of all digital inputs of port in one transaction.
+ *********************************************************************************************************
+ * @param [in] port - Digital input port index, less than DI_PORTS_NUMBER.
+ * @return Bitmask of port inputs, bit is set for input in ::DI_state_ON.
+ ********************************************************************************************************/
+DI_mask_T DI_getInputs(uint32_t port);
+
+//! Listener of DI changes, called by DI layer on thread detecting them
+typedef void (*DI_change_listener_T)(void);
+
+/********************************************************************************************************
+ * @details Function returns pins of port changed since previous call and clears them. Changes are
+ *          latched by DI layer as interrupt status register of GPIO controller does, so pin changed
+ *          several times is reported once and changes are never lost. Call for port 0 drains
+ *          DI_getChangeFd(), so ports are read in order starting from port 0.
+ *********************************************************************************************************
+ * @param [in] port - Digital input port index, less than DI_PORTS_NUMBER.
+ * @return Bitmask of port inputs changed since previous call.
+ ********************************************************************************************************/
+DI_mask_T DI_getChanges(uint32_t port);
+
+/********************************************************************************************************
+ * @details Function returns file descriptor readable (poll, epoll) when there are latched changes.
+ *          Consumer doesn't read it, DI_getChanges() of port 0 drains it and DI_getChanges() of
+ *          all ports take the changes. Change latched after drain makes it readable again.
+ *********************************************************************************************************
+ * @param [in] Nothing.
+ * @return File descriptor, -1 if DI layer doesn't detect changes.
+ ********************************************************************************************************/
+int DI_getChangeFd(void);
+
+/********************************************************************************************************
+ * @details Function sets listener called when changes are latched, e.g. to wake up scheduler routine
+ *          which reads them.
+ *********************************************************************************************************
+ * @param [in] listener - Listener function, NULL to remove.
+ * @return Nothing.
+ ********************************************************************************************************/
+void DI_setChangeListener(DI_change_listener_T listener);
@@ -1,5 +1,12 @@
 #pragma once
 
+#include "types.h"
+
+// Number of DO pins on board, simulation of large relay banks may extend it beyond named indexes
+#ifndef DO_PINS_NUMBER
+#define DO_PINS_NUMBER 16u
+#endif
+
 //! Digital Output (DO) indexes
 typedef enum DO_index_ENUM
 {
@@ -19,7 +26,7 @@ typedef enum DO_index_ENUM
     DO_index_13 = 13u, //!< Index of DO pin 13
     DO_index_14 = 14u, //!< Index of DO pin 14
     DO_index_15 = 15u, //!< Index of DO pin 15
-    DO_index_NUMBER = 16u //!< Number of DO indexes
+    DO_index_NUMBER = DO_PINS_NUMBER //!< Number of DO indexes
 } DO_index_E;
 
 //! Digital Output (DO) states
@@ -30,6 +37,15 @@ typedef enum DO_state_ENUM
     DO_state_NUMBER = 2u //!< Number of digital output states
 } DO_state_E;
 
+//! Digital outputs are grouped in ports written at once, bit n of port p is DO pin p * DO_PORT_WIDTH + n
+typedef uint32_t DO_mask_T;
+
+enum
+{
+    DO_PORT_WIDTH = 32u, //!< Number of DO pins in port
+    DO_PORTS_NUMBER = (DO_index_NUMBER + DO_PORT_WIDTH - 1u) / DO_PORT_WIDTH //!< Number of DO ports
+};
+
 /********************************************************************************************************
  * @details Function sets state on digital output.
  *********************************************************************************************************
@@ -38,3 +54,14 @@ typedef enum DO_state_ENUM
  * @return Nothing.
  ********************************************************************************************************/
 void DO_setOutputState(DO_index_E index, DO_state_E state);
+
+/********************************************************************************************************
+ * @details Function sets states of several digital outputs of port in one transaction, outputs
+ *          not selected by mask keep their states.
+ *********************************************************************************************************
+ * @param [in] port - Digital output port index, less than DO_PORTS_NUMBER.
+ * @param [in] mask - Bitmask of outputs to be set.
+ * @param [in] states - Bitmask of states, bit is set for ::DO_state_ON.
+ * @return Nothing.
+ ********************************************************************************************************/
+void DO_setOutputs(uint32_t port, DO_mask_T mask, DO_mask_T states);
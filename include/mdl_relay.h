@@ -27,23 +27,150 @@ typedef struct RELAY_config
     RELAY_type_E type;
     DO_index_E control_index;
     DI_index_E feedback_index;
-    uint32_t response_ms; // relay responce time
+    uint32_t response_ms; // relay responce time, switching with feedback may complete earlier
 } RELAY_config_T;
 
 enum {RELAY_WO_FEEDBACK = DI_index_NUMBER}; // relay without feedback line
 
+// What became of switching command, REJECTED is 0 so result may be tested as bool
+typedef enum RELAY_command_ENUM
+{
+    RELAY_command_REJECTED = 0U, // not inited, invalid relay_id or relay in error
+    RELAY_command_APPLIED, // relay starts switching
+    RELAY_command_LATCHED, // relay is switching, command is applied as soon as switching completes
+    RELAY_command_MERGED, // relay is in commanded state, switching to it or has it latched already
+} RELAY_command_E;
+
+// Outcome of command with completion
+typedef enum RELAY_result_ENUM
+{
+    RELAY_result_OK = 0U, // relay is in commanded state
+    RELAY_result_WELDED, // switching failed
+    RELAY_result_CONSTANTLY_OPEN, // switching failed
+    RELAY_result_CANCELLED, // latched command replaced or dropped, or module deinited
+} RELAY_result_E;
+
+typedef void (*RELAY_completion_func_T)(uint32_t relay_id, RELAY_result_E result, void* arg);
+
 typedef uint32_t RELAY_listener_id_T;
 typedef void (*RELAY_state_listener_func_T)(uint32_t relay_id, RELAY_state_E state);
 typedef void (*RELAY_error_listener_func_T)(uint32_t relay_id, RELAY_error_E error);
 
+// Functions below work on default instance, bound to board DI/DO and to scheduler. Instances of
+// RELAY_ctx_* functions at the end are independent boards with own I/O, e.g. of gateway process.
+
+// Init with module storage, relays_number is limited by MAX_SUPPORTED_RELAYS_NUMBER
+// Config with control_index or feedback_index out of board pins is rejected, RELAY_WO_FEEDBACK is
+// valid feedback_index.
 bool RELAY_init(RELAY_config_T* config, uint32_t relays_number);
+
+// Init with caller storage of RELAY_get_storage_size() bytes, aligned as malloc() does, misaligned
+// one is rejected. Storage should stay valid till RELAY_deinit() and last RELAY_get_state/error()
+// call.
+size_t RELAY_get_storage_size(uint32_t relays_number);
+bool RELAY_init_with_storage(
+    RELAY_config_T* config,
+    uint32_t relays_number,
+    void* storage,
+    size_t storage_size);
 bool RELAY_is_inited();
 void RELAY_deinit();
 
 SCHEDULER_routine_state_E RELAY_routine(void);
 
-bool RELAY_open(uint32_t relay_id);
-bool RELAY_close(uint32_t relay_id);
+// Parallel RELAY_routine: relays are split in RELAY_SHARD_SIZE shards swept by worker pool,
+// 0 - serial routine on scheduler thread (default). Pool is stopped by RELAY_deinit().
+bool RELAY_set_workers(uint32_t workers_number);
+
+// Change-driven checks: relays on DI pins changed since previous pass are checked at once, all of
+// them every RELAY_SELF_CHECK_PERIOD_MS, and DI change listener wakes routine up. Enable only when
+// DI layer latches changes, e.g. simulation with SIMU_routine() running. Disabled by default, all
+// relays are checked on each pass then.
+void RELAY_set_change_checks(bool enabled);
+
+// Command received during switching is latched, later one replaces it, see RELAY_command_E
+RELAY_command_E RELAY_open(uint32_t relay_id);
+RELAY_command_E RELAY_close(uint32_t relay_id);
+
+// Command with completion called once, when relay gets to commanded state, switching to it fails
+// or command is cancelled. Completions are delivered as notifications to listeners are, after
+// state notification of relay. Completion isn't called when command is rejected, also when
+// RELAY_COMPLETIONS_NUMBER commands with completion are outstanding.
+RELAY_command_E RELAY_open_with_completion(
+    uint32_t relay_id, RELAY_completion_func_T func, void* arg);
+RELAY_command_E RELAY_close_with_completion(
+    uint32_t relay_id, RELAY_completion_func_T func, void* arg);
+
+// Batch commands: relays start switching at one time and their DO lines are set per port at once.
+// Return number of commands not rejected, invalid relay ids are skipped.
+uint32_t RELAY_open_many(const uint32_t* relay_ids, uint32_t number);
+uint32_t RELAY_close_many(const uint32_t* relay_ids, uint32_t number);
+
+// Async commands: queued without waiting for relay or DO, applied or latched by next RELAY_routine
+// pass. Return false if module is not inited, relay_id is invalid or queue is full.
+bool RELAY_open_async(uint32_t relay_id);
+bool RELAY_close_async(uint32_t relay_id);
+
+typedef uint32_t RELAY_timer_id_T;
+
+// Scheduled commands: applied or latched by RELAY_routine pass at tick of CLOCK_getTicks() time,
+// commands due at one tick as batch. Timer due already fires on next pass. Return false if module
+// is not inited, relay_id is invalid or RELAY_TIMERS_NUMBER timers are pending. timer_id may be
+// NULL when timer isn't going to be cancelled. Timers pending at RELAY_deinit() are dropped.
+bool RELAY_open_at(uint32_t relay_id, CLOCK_ticks_T at, RELAY_timer_id_T* timer_id);
+bool RELAY_close_at(uint32_t relay_id, CLOCK_ticks_T at, RELAY_timer_id_T* timer_id);
+bool RELAY_open_after(uint32_t relay_id, uint32_t delay_ms, RELAY_timer_id_T* timer_id);
+bool RELAY_close_after(uint32_t relay_id, uint32_t delay_ms, RELAY_timer_id_T* timer_id);
+
+// Return true if timer is cancelled, false if it has fired or is cancelled already
+bool RELAY_cancel_timer(RELAY_timer_id_T timer_id);
+uint32_t RELAY_get_pending_timers(void);
+
+// Switching pattern: relay is closed for on_ms, then opened for off_ms, count times. Pulse is
+// pattern of count 1 which needs no off_ms.
+typedef struct RELAY_pattern
+{
+    uint32_t on_ms;
+    uint32_t off_ms;
+    uint32_t count; // number of on phases, 0 - till stopped
+} RELAY_pattern_T;
+
+// Pattern is run by state machine: each edge is switching with its feedback check, edge due while
+// relay is still switching is given as soon as it completes. Pattern starts with close, restarts
+// pattern running already and ends with open. It stops on error, on RELAY_stop_pattern() leaving
+// relay as it is and on command, e.g. RELAY_open(). Return false if module is not inited,
+// relay_id or pattern is invalid or relay is in error.
+bool RELAY_start_pattern(uint32_t relay_id, const RELAY_pattern_T* pattern);
+bool RELAY_pulse(uint32_t relay_id, uint32_t on_ms);
+bool RELAY_stop_pattern(uint32_t relay_id); // false if pattern isn't running
+bool RELAY_is_pattern_running(uint32_t relay_id);
+
+typedef enum RELAY_wait_ENUM
+{
+    RELAY_wait_ALL, // till all relays are in state
+    RELAY_wait_ANY, // till any relay is in state
+} RELAY_wait_E;
+
+// Block till relays are in state, woken by state machine as soon as switching is confirmed.
+// Return true when they are, false on timeout, when relay is in error, relay_id is invalid or
+// module is deinited. On virtual clock waiting thread advances scheduler time as it waits.
+bool RELAY_wait_state(uint32_t relay_id, RELAY_state_E state, uint32_t timeout_ms);
+bool RELAY_wait_states(
+    const uint32_t* relay_ids,
+    uint32_t number,
+    RELAY_state_E state,
+    RELAY_wait_E mode,
+    uint32_t timeout_ms);
+
+typedef struct RELAY_queue_stats
+{
+    uint32_t depth; // commands waiting in queue
+    uint32_t accepted; // commands queued since start
+    uint32_t dropped; // commands rejected as queue was full or dropped by RELAY_deinit()
+    uint32_t overflows; // notifications which waited for room in full queue, 0 for commands
+} RELAY_queue_stats_T;
+
+void RELAY_get_queue_stats(RELAY_queue_stats_T* stats);
 
 RELAY_state_E RELAY_get_state(uint32_t relay_id);
 RELAY_error_E RELAY_get_error(uint32_t relay_id);
@@ -57,3 +184,128 @@ bool RELAY_add_error_listener(
     uint32_t relay_id,
     RELAY_error_listener_func_T func,
     RELAY_listener_id_T* listener_id);
+
+// Listeners are called without module or relay locks held, so they may call module API. State
+// and error notifications are queued and delivered in order per relay: by RELAY_routine after its
+// pass (default) or by RELAY_dispatch_events() called from application thread when pump is set.
+// Notifications still queued at RELAY_deinit() are dropped.
+bool RELAY_set_event_pump(bool enabled);
+
+// Deliver up to max_events queued notifications on calling thread, return number delivered.
+// Returns 0 when called from listener while other delivery is in progress.
+uint32_t RELAY_dispatch_events(uint32_t max_events);
+
+// depth - notifications waiting, accepted - queued since start, dropped - dropped by deinit,
+// overflows - notifications of relays which waited for room in full queue, relay doesn't get new
+// verdict till its notification is queued, so no state is skipped
+void RELAY_get_event_stats(RELAY_queue_stats_T* stats);
+
+//
+// Instance API: each function of default instance has RELAY_ctx_* counterpart taking instance
+//
+
+typedef struct RELAY_ctx RELAY_ctx_T;
+
+// Listeners of instance get instance which fired and arg given with them, so one function may
+// serve relays of several boards
+typedef void (*RELAY_ctx_state_listener_func_T)(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_state_E state, void* arg);
+typedef void (*RELAY_ctx_error_listener_func_T)(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_error_E error, void* arg);
+
+// Board I/O of instance, functions get arg given with them. Functions are called under instance
+// locks, so they may not call instance API. Optional ones may be NULL:
+// get_changes - DI pins changed since previous call, as DI_getChanges(). With it relays on changed
+//     pins are checked at once and all of them every RELAY_SELF_CHECK_PERIOD_MS, without it all
+//     relays are checked on each RELAY_ctx_routine() pass.
+// wakeup - instance needs RELAY_ctx_routine() call in delay_ms, 0 - as soon as possible.
+// get_ticks - time of board, e.g. own virtual clock of simulated board, CLOCK_getTicks() if NULL.
+typedef struct RELAY_hal
+{
+    DI_mask_T (*get_inputs)(void* arg, uint32_t port);
+    void (*set_outputs)(void* arg, uint32_t port, DO_mask_T mask, DO_mask_T states);
+    DI_mask_T (*get_changes)(void* arg, uint32_t port);
+    void (*wakeup)(void* arg, uint32_t delay_ms);
+    CLOCK_ticks_T (*get_ticks)(void* arg);
+    void* arg;
+} RELAY_hal_T;
+
+// Create instance in caller memory of RELAY_ctx_get_size() bytes, aligned as malloc() does, NULL
+// for misaligned one. Memory may be released after RELAY_ctx_deinit(), when no other thread uses instance.
+size_t RELAY_ctx_get_size(void);
+RELAY_ctx_T* RELAY_ctx_create(void* memory, size_t memory_size, const RELAY_hal_T* hal);
+RELAY_ctx_T* RELAY_get_default_ctx(void);
+
+// Init with caller storage of RELAY_get_storage_size() bytes, see RELAY_init_with_storage()
+bool RELAY_ctx_init(
+    RELAY_ctx_T* ctx,
+    RELAY_config_T* config,
+    uint32_t relays_number,
+    void* storage,
+    size_t storage_size);
+bool RELAY_ctx_is_inited(RELAY_ctx_T* ctx);
+void RELAY_ctx_deinit(RELAY_ctx_T* ctx);
+
+// Instances are swept independently, so each one may be driven by own thread on own core.
+// Each instance has own worker pool in parallel mode.
+SCHEDULER_routine_state_E RELAY_ctx_routine(RELAY_ctx_T* ctx);
+bool RELAY_ctx_set_workers(RELAY_ctx_T* ctx, uint32_t workers_number);
+
+RELAY_command_E RELAY_ctx_open(RELAY_ctx_T* ctx, uint32_t relay_id);
+RELAY_command_E RELAY_ctx_close(RELAY_ctx_T* ctx, uint32_t relay_id);
+RELAY_command_E RELAY_ctx_open_with_completion(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_completion_func_T func, void* arg);
+RELAY_command_E RELAY_ctx_close_with_completion(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_completion_func_T func, void* arg);
+uint32_t RELAY_ctx_open_many(RELAY_ctx_T* ctx, const uint32_t* relay_ids, uint32_t number);
+uint32_t RELAY_ctx_close_many(RELAY_ctx_T* ctx, const uint32_t* relay_ids, uint32_t number);
+bool RELAY_ctx_open_async(RELAY_ctx_T* ctx, uint32_t relay_id);
+bool RELAY_ctx_close_async(RELAY_ctx_T* ctx, uint32_t relay_id);
+void RELAY_ctx_get_queue_stats(RELAY_ctx_T* ctx, RELAY_queue_stats_T* stats);
+// at is tick of board time, see RELAY_hal_T::get_ticks
+bool RELAY_ctx_open_at(
+    RELAY_ctx_T* ctx, uint32_t relay_id, CLOCK_ticks_T at, RELAY_timer_id_T* timer_id);
+bool RELAY_ctx_close_at(
+    RELAY_ctx_T* ctx, uint32_t relay_id, CLOCK_ticks_T at, RELAY_timer_id_T* timer_id);
+bool RELAY_ctx_open_after(
+    RELAY_ctx_T* ctx, uint32_t relay_id, uint32_t delay_ms, RELAY_timer_id_T* timer_id);
+bool RELAY_ctx_close_after(
+    RELAY_ctx_T* ctx, uint32_t relay_id, uint32_t delay_ms, RELAY_timer_id_T* timer_id);
+bool RELAY_ctx_cancel_timer(RELAY_ctx_T* ctx, RELAY_timer_id_T timer_id);
+uint32_t RELAY_ctx_get_pending_timers(RELAY_ctx_T* ctx);
+bool RELAY_ctx_start_pattern(RELAY_ctx_T* ctx, uint32_t relay_id, const RELAY_pattern_T* pattern);
+bool RELAY_ctx_pulse(RELAY_ctx_T* ctx, uint32_t relay_id, uint32_t on_ms);
+bool RELAY_ctx_stop_pattern(RELAY_ctx_T* ctx, uint32_t relay_id);
+bool RELAY_ctx_is_pattern_running(RELAY_ctx_T* ctx, uint32_t relay_id);
+
+// Timeout is waited in real time, instance should be driven by other thread
+bool RELAY_ctx_wait_state(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_state_E state, uint32_t timeout_ms);
+bool RELAY_ctx_wait_states(
+    RELAY_ctx_T* ctx,
+    const uint32_t* relay_ids,
+    uint32_t number,
+    RELAY_state_E state,
+    RELAY_wait_E mode,
+    uint32_t timeout_ms);
+
+RELAY_state_E RELAY_ctx_get_state(RELAY_ctx_T* ctx, uint32_t relay_id);
+RELAY_error_E RELAY_ctx_get_error(RELAY_ctx_T* ctx, uint32_t relay_id);
+
+bool RELAY_ctx_add_state_listener(
+    RELAY_ctx_T* ctx,
+    uint32_t relay_id,
+    RELAY_ctx_state_listener_func_T func,
+    void* arg,
+    RELAY_listener_id_T* listener_id);
+
+bool RELAY_ctx_add_error_listener(
+    RELAY_ctx_T* ctx,
+    uint32_t relay_id,
+    RELAY_ctx_error_listener_func_T func,
+    void* arg,
+    RELAY_listener_id_T* listener_id);
+
+bool RELAY_ctx_set_event_pump(RELAY_ctx_T* ctx, bool enabled);
+uint32_t RELAY_ctx_dispatch_events(RELAY_ctx_T* ctx, uint32_t max_events);
+void RELAY_ctx_get_event_stats(RELAY_ctx_T* ctx, RELAY_queue_stats_T* stats);
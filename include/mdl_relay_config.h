@@ -15,23 +15,143 @@
 #include <stdio.h>
 #include <time.h>
 
-// Logging
-#define LOG(...) printf(__VA_ARGS__), printf("\n")
+#include "trace.h"
 
-// Syncronization
-#define LOCK_DEFINE static pthread_mutex_t lock // module scope
-#define LOCK_INIT pthread_mutex_init(&lock, NULL)
-#define LOCK pthread_mutex_lock(&lock)
-#define UNLOCK pthread_mutex_unlock(&lock)
+// Logging: binary trace records, output by TRACE_flush(). Levels above RELAY_LOG_LEVEL are
+// compiled out, LOG_ERROR is used on relay faults and rejected commands, LOG_DEBUG on
+// RELAY_routine and getters paths.
+#ifndef RELAY_LOG_LEVEL
+#ifdef RELAY_LOG_DISABLED
+#define RELAY_LOG_LEVEL TRACE_LEVEL_NONE
+#else
+#define RELAY_LOG_LEVEL TRACE_LEVEL_DEBUG
+#endif
+#endif
+
+#if RELAY_LOG_LEVEL >= TRACE_LEVEL_ERROR
+#define LOG_ERROR(...) TRACE(TRACE_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...)
+#endif
+
+#if RELAY_LOG_LEVEL >= TRACE_LEVEL_INFO
+#define LOG(...) TRACE(TRACE_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+
+#if RELAY_LOG_LEVEL >= TRACE_LEVEL_DEBUG
+#define LOG_DEBUG(...) TRACE(TRACE_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...)
+#endif
+
+// Syncronization, instance scope: exclusive for init/deinit, shared for per relay operations
+#define LOCK_T pthread_rwlock_t
+#define LOCK_INITIALIZER PTHREAD_RWLOCK_INITIALIZER
+#define LOCK_INIT(l) pthread_rwlock_init(&(l), NULL)
+#define LOCK(l) pthread_rwlock_wrlock(&(l))
+#define LOCK_SHARED(l) pthread_rwlock_rdlock(&(l))
+#define UNLOCK(l) pthread_rwlock_unlock(&(l))
+
+// Thread local storage
+#define THREAD_LOCAL __thread
+
+// Syncronization, relay scope: serializes state machine steps of one relay
+#define RELAY_LOCK_T pthread_mutex_t
+#define RELAY_LOCK_INIT(l) pthread_mutex_init(&(l), NULL)
+#define RELAY_LOCK(l) pthread_mutex_lock(&(l))
+#define RELAY_UNLOCK(l) pthread_mutex_unlock(&(l))
+#define RELAY_TRYLOCK(l) (pthread_mutex_trylock(&(l)) == 0)
+#define RELAY_LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+
+// Syncronization, state waiters: woken on published relay state, deadline is on monotonic clock
+#define RELAY_COND_T pthread_cond_t
+#define RELAY_COND_INIT(c)                                 \
+    do                                                     \
+    {                                                      \
+        pthread_condattr_t attr;                           \
+        pthread_condattr_init(&attr);                      \
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); \
+        pthread_cond_init(&(c), &attr);                    \
+        pthread_condattr_destroy(&attr);                   \
+    } while (0)
+#define RELAY_COND_WAIT(c, l, deadline) (pthread_cond_timedwait(&(c), &(l), &(deadline)) == 0)
+#define RELAY_COND_BROADCAST(c) pthread_cond_broadcast(&(c))
+#define RELAY_DEADLINE_T struct timespec
+#define RELAY_DEADLINE_SET(d, ms)                                  \
+    do                                                             \
+    {                                                              \
+        clock_gettime(CLOCK_MONOTONIC, &(d));                      \
+        (d).tv_sec += (time_t)((ms) / 1000u);                      \
+        (d).tv_nsec += (long)((ms) % 1000u) * 1000000L;            \
+        if ((d).tv_nsec >= 1000000000L)                            \
+        {                                                          \
+            (d).tv_sec += 1;                                       \
+            (d).tv_nsec -= 1000000000L;                            \
+        }                                                          \
+    } while (0)
 
 #else
+#define LOG_ERROR(...)
 #define LOG(...)
+#define LOG_DEBUG(...)
 #endif
 
+// Atomics, used to publish relay state for lock-free readers
+#define ATOMIC_LOAD(v) __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#define ATOMIC_CAS(v, expected, x) \
+    __atomic_compare_exchange_n(&(v), &(expected), (x), true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define ATOMIC_ADD(v, x) __atomic_fetch_add(&(v), (x), __ATOMIC_RELAXED)
+#define ATOMIC_OR(v, x) __atomic_fetch_or(&(v), (x), __ATOMIC_RELEASE)
+#define ATOMIC_AND(v, x) __atomic_fetch_and(&(v), (x), __ATOMIC_RELEASE)
+#define ATOMIC_EXCHANGE(v, x) __atomic_exchange_n(&(v), (x), __ATOMIC_ACQ_REL)
+#define ATOMIC_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+// Index of lowest set bit, x should not be 0
+#define BIT_SCAN(x) ((uint32_t)__builtin_ctzll(x))
+
 #ifndef MAX_SUPPORTED_RELAYS_NUMBER
 #define MAX_SUPPORTED_RELAYS_NUMBER 4u
 #endif
 
+// Number of relays swept by one task of parallel RELAY_routine, see RELAY_set_workers()
+#ifndef RELAY_SHARD_SIZE
+#define RELAY_SHARD_SIZE 64u
+#endif
+
+// Period of full feedback check of stable relays when board reports DI changes, see RELAY_hal_T
+#ifndef RELAY_SELF_CHECK_PERIOD_MS
+#define RELAY_SELF_CHECK_PERIOD_MS 1000u
+#endif
+
+// Time feedback confirming switching should be stable for to complete it before response time,
+// longer than contact bounce
+#ifndef RELAY_SETTLE_MS
+#define RELAY_SETTLE_MS 5u
+#endif
+
+// Capacity of async commands queue, power of 2, see RELAY_open_async()
+#ifndef RELAY_QUEUE_SIZE
+#define RELAY_QUEUE_SIZE 64u
+#endif
+
+// Capacity of state and error notifications queue, power of 2, see RELAY_dispatch_events()
+#ifndef RELAY_EVENT_QUEUE_SIZE
+#define RELAY_EVENT_QUEUE_SIZE 64u
+#endif
+
+// Number of commands with completion outstanding at once, see RELAY_open_with_completion()
+#ifndef RELAY_COMPLETIONS_NUMBER
+#define RELAY_COMPLETIONS_NUMBER 64u
+#endif
+
+// Number of scheduled commands pending at once, up to 65535, see RELAY_close_at()
+#ifndef RELAY_TIMERS_NUMBER
+#define RELAY_TIMERS_NUMBER 64u
+#endif
+
 #ifndef MAX_STATE_LISTENERS_PER_RELAY
 #define MAX_STATE_LISTENERS_PER_RELAY 1u
 #endif
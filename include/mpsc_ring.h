@@ -0,0 +1,74 @@
+#pragma once
+
+// Bounded lock-free ring for many producers and one consumer (MPSC). Each cell carries sequence
+// number, so producers reserve cells by one CAS and consumer sees only completely written ones.
+
+#include <stddef.h>
+
+#include "types.h"
+
+enum {MPSC_CACHE_LINE = 64u};
+
+// Storage size for static allocation, cell is 8 bytes sequence number followed by aligned element
+#define MPSC_STORAGE_SIZE(capacity, element_size) \
+    ((size_t)(capacity) * (8u + (((element_size) + 7u) & ~7u)))
+
+typedef struct MPSC_ring
+{
+    uint8_t* cells; // capacity cells of cell_size bytes: sequence number followed by element
+    uint32_t cell_size;
+    uint32_t element_size;
+    uint32_t mask; // capacity - 1
+
+    uint8_t pad0[MPSC_CACHE_LINE];
+    uint32_t head; // next position to push, shared by producers
+    uint8_t pad1[MPSC_CACHE_LINE];
+    uint32_t tail; // next position to pop, owned by consumer
+    uint8_t pad2[MPSC_CACHE_LINE];
+} MPSC_ring_T;
+
+/*********************************************************************************************************
+ * @brief Retrieve size of storage needed for ring.
+ *********************************************************************************************************
+ * @param [in] capacity - Number of elements, power of 2.
+ * @param [in] element_size - Size of element in bytes.
+ * @return Storage size in bytes.
+ ********************************************************************************************************/
+size_t MPSC_get_storage_size(uint32_t capacity, uint32_t element_size);
+
+/*********************************************************************************************************
+ * @brief Init empty ring in caller storage, aligned as malloc() does.
+ *********************************************************************************************************
+ * @param [out] ring - Ring to be inited.
+ * @param [in] storage - Storage of MPSC_get_storage_size() bytes.
+ * @param [in] capacity - Number of elements, power of 2.
+ * @param [in] element_size - Size of element in bytes.
+ * @return true if inited, false if capacity is not power of 2.
+ ********************************************************************************************************/
+bool MPSC_init(MPSC_ring_T* ring, void* storage, uint32_t capacity, uint32_t element_size);
+
+/*********************************************************************************************************
+ * @brief Push element, can be called by any thread, never blocks.
+ *********************************************************************************************************
+ * @param [in] ring - Ring.
+ * @param [in] element - Element of element_size bytes to be copied in ring.
+ * @return true if pushed, false if ring is full.
+ ********************************************************************************************************/
+bool MPSC_push(MPSC_ring_T* ring, const void* element);
+
+/*********************************************************************************************************
+ * @brief Pop element, should be called by one consumer thread at a time.
+ *********************************************************************************************************
+ * @param [in] ring - Ring.
+ * @param [out] element - Element of element_size bytes copied from ring.
+ * @return true if popped, false if ring is empty.
+ ********************************************************************************************************/
+bool MPSC_pop(MPSC_ring_T* ring, void* element);
+
+/*********************************************************************************************************
+ * @brief Retrieve number of elements in ring, approximate when called concurrently with push/pop.
+ *********************************************************************************************************
+ * @param [in] ring - Ring.
+ * @return Number of elements.
+ ********************************************************************************************************/
+uint32_t MPSC_get_depth(const MPSC_ring_T* ring);
@@ -1,7 +1,20 @@
 #pragma once
 
-// Simple Scheduler
+// Simple Scheduler: runs several periodic routines on one thread, by priority when they are due
+// at the same time
 
+#include "types.h"
+
+// Default period of routine call when routine doesn't request earlier wakeup
+#ifndef SCHEDULER_PERIOD_MS
+#define SCHEDULER_PERIOD_MS 100u
+#endif
+
+#ifndef MAX_SCHEDULER_ROUTINES
+#define MAX_SCHEDULER_ROUTINES 8u
+#endif
+
+// Routine returns SCHEDULER_ACTIVE to stay scheduled, SCHEDULER_NOTHING_TODO to be retired
 typedef enum SCHEDULER_routine_state_ENUM
 {
     SCHEDULER_NOTHING_TODO,
@@ -9,7 +22,95 @@ typedef enum SCHEDULER_routine_state_ENUM
 } SCHEDULER_routine_state_E;
 typedef SCHEDULER_routine_state_E (*SCHEDULER_rutine_T)(void);
 
+typedef uint32_t SCHEDULER_routine_id_T;
+
+// clang-format off
+enum { SCHEDULER_PRIORITY_LOW = 0U, SCHEDULER_PRIORITY_NORMAL = 50U, SCHEDULER_PRIORITY_HIGH = 100U };
+// clang-format on
+
+/*********************************************************************************************************
+ * @brief Add routine with default period and normal priority.
+ *********************************************************************************************************
+ * @param [in] routine - Routine to be called.
+ * @return Nothing.
+ ********************************************************************************************************/
 void SCHEDULER_add(SCHEDULER_rutine_T routine);
+
+/*********************************************************************************************************
+ * @brief Add routine, it can be done before and after SCHEDULER_run(), also after scheduler thread
+ *        has finished, it is started again then.
+ *********************************************************************************************************
+ * @param [in] routine - Routine to be called.
+ * @param [in] period_ms - Period of routine call in milliseconds.
+ * @param [in] priority - Priority of routine, greater value is called first when several are due.
+ * @param [out] id - Routine id for SCHEDULER_remove() and SCHEDULER_get_overruns(), can be NULL.
+ * @return true if added, false if there is no free slot.
+ ********************************************************************************************************/
+bool SCHEDULER_add_routine(
+    SCHEDULER_rutine_T routine,
+    uint32_t period_ms,
+    uint32_t priority,
+    SCHEDULER_routine_id_T* id);
+
+/*********************************************************************************************************
+ * @brief Remove routine. When called from other thread waits for routine call in progress to finish.
+ *********************************************************************************************************
+ * @param [in] id - Routine id.
+ * @return true if removed, false if there is no such routine.
+ ********************************************************************************************************/
+bool SCHEDULER_remove(SCHEDULER_routine_id_T id);
+
+/*********************************************************************************************************
+ * @brief Retrieve number of periods routine has missed, because of own or other routines execution.
+ *********************************************************************************************************
+ * @param [in] id - Routine id.
+ * @return Number of missed periods.
+ ********************************************************************************************************/
+uint32_t SCHEDULER_get_overruns(SCHEDULER_routine_id_T id);
+
+/*********************************************************************************************************
+ * @brief Start scheduler thread, it finishes when all routines are retired or removed, and is
+ *        started again by routine added after that. SCHEDULER_wait() waits for it to finish. With
+ *        virtual clock (CLOCK_source_VIRTUAL) thread is not started, routines are called by
+ *        SCHEDULER_advance() and SCHEDULER_wait() instead.
+ *********************************************************************************************************/
 void SCHEDULER_run(void);
 void SCHEDULER_wait(void);
+
+/*********************************************************************************************************
+ * @brief Advance virtual clock calling routines on calling thread as they are due, clock jumps from
+ *        one deadline to next one without waiting. Ignored without virtual clock.
+ *********************************************************************************************************
+ * @param [in] ms - Time to advance in milliseconds.
+ * @return Nothing.
+ ********************************************************************************************************/
+void SCHEDULER_advance(uint32_t ms);
+
+/*********************************************************************************************************
+ * @brief Advance virtual clock to nearest routine deadline, not further than max_ms, calling routines
+ *        due now and at that deadline, e.g. for waiting on virtual clock with timeout.
+ *********************************************************************************************************
+ * @param [in] max_ms - Maximal time to advance in milliseconds.
+ * @return Time advanced in milliseconds, rounded up; max_ms when all routines are retired or
+ *         without virtual clock, time doesn't matter to routines then.
+ ********************************************************************************************************/
+uint32_t SCHEDULER_advance_next(uint32_t max_ms);
 void* scheduler(void* arg);
+
+/*********************************************************************************************************
+ * @brief Request routine call as soon as possible, e.g. when new command is submitted.
+ *********************************************************************************************************
+ * @param [in] routine - Routine to be called.
+ * @return Nothing.
+ ********************************************************************************************************/
+void SCHEDULER_wakeup(SCHEDULER_rutine_T routine);
+
+/*********************************************************************************************************
+ * @brief Request routine call not later than after given delay, e.g. at nearest pending deadline.
+ *        Request is valid for the next sleep only, routine should renew it on each call.
+ *********************************************************************************************************
+ * @param [in] routine - Routine to be called.
+ * @param [in] delay_ms - Delay in milliseconds from now.
+ * @return Nothing.
+ ********************************************************************************************************/
+void SCHEDULER_wakeup_in(SCHEDULER_rutine_T routine, uint32_t delay_ms);
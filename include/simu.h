@@ -8,4 +8,84 @@ typedef enum SIMU_mode_ENUM
     SIMU_mode_WRONG
 } SIMU_mode_E;
 
+// Distribution of contacts actuation delay: FIXED - delay_ms, UNIFORM - delay_ms +- spread_ms,
+// NORMAL - mean delay_ms and standard deviation spread_ms
+typedef enum SIMU_delay_ENUM
+{
+    SIMU_delay_FIXED,
+    SIMU_delay_UNIFORM,
+    SIMU_delay_NORMAL,
+} SIMU_delay_E;
+
+// Fault model of one simulated relay, probabilities are per actuation in parts per million
+typedef struct SIMU_model
+{
+    SIMU_delay_E delay;
+    uint32_t delay_ms;
+    uint32_t spread_ms;
+    uint32_t bounce_ms; // contacts bounce after actuation, feedback toggles randomly
+    uint32_t weld_ppm; // contacts weld on open actuation and stay closed till next actuation
+    uint32_t stuck_open_ppm; // contacts stay open on close actuation
+} SIMU_model_T;
+
+typedef enum SIMU_fault_ENUM
+{
+    SIMU_fault_NO,
+    SIMU_fault_WELDED,
+    SIMU_fault_STUCK_OPEN,
+} SIMU_fault_E;
+
+// Fault of last actuation and time since contacts should be in commanded state
+typedef struct SIMU_fault
+{
+    SIMU_fault_E type;
+    CLOCK_ticks_T since;
+} SIMU_fault_T;
+
+typedef struct SIMU_stats
+{
+    uint32_t actuations;
+    uint32_t welds;
+    uint32_t stuck_opens;
+} SIMU_stats_T;
+
+// Simulated board instance with own virtual clock, starting at 0. Boards are independent, so
+// each one may run on own thread, driven by SIMU_ctx_advance() and SIMU_ctx_routine() calls.
+typedef struct SIMU_ctx SIMU_ctx_T;
+
+size_t SIMU_ctx_get_size(void);
+SIMU_ctx_T* SIMU_ctx_create(void* memory, size_t memory_size);
+
+// Same as SIMU_init(), SIMU_set_seed(), ... for board instance, init resets its clock to 0
+void SIMU_ctx_init(
+    SIMU_ctx_T* simu, SIMU_mode_E mode, RELAY_config_T* config, uint32_t relays_number);
+void SIMU_ctx_set_seed(SIMU_ctx_T* simu, uint64_t seed);
+bool SIMU_ctx_set_model(SIMU_ctx_T* simu, uint32_t relay_id, const SIMU_model_T* model);
+bool SIMU_ctx_get_fault(SIMU_ctx_T* simu, uint32_t relay_id, SIMU_fault_T* fault);
+void SIMU_ctx_get_stats(SIMU_ctx_T* simu, SIMU_stats_T* stats);
+
+// Latch DI changes of simulated contacts up to board time, call after each clock move
+void SIMU_ctx_routine(SIMU_ctx_T* simu);
+
+void SIMU_ctx_advance(SIMU_ctx_T* simu, CLOCK_ticks_T ticks);
+CLOCK_ticks_T SIMU_ctx_get_ticks(SIMU_ctx_T* simu);
+
+// HAL of board for RELAY_ctx_init(): DI/DO ports, latched changes and board clock
+void SIMU_ctx_get_hal(SIMU_ctx_T* simu, RELAY_hal_T* hal);
+
+// Init board with ideal relays: no delay, bounce or faults. Relays sharing DO pin share contacts.
 void SIMU_init(SIMU_mode_E mode, RELAY_config_T* config, uint32_t relays_number);
+
+// Seed of random faults, applied by next SIMU_init(), same seed on virtual clock repeats the run
+void SIMU_set_seed(uint64_t seed);
+
+bool SIMU_set_model(uint32_t relay_id, const SIMU_model_T* model);
+bool SIMU_get_fault(uint32_t relay_id, SIMU_fault_T* fault);
+void SIMU_get_stats(SIMU_stats_T* stats);
+
+// Scheduler routine latching DI changes of simulated contacts when they happen, see
+// DI_getChanges(). Add it with high priority, so changes are latched before routines reading them.
+SCHEDULER_routine_state_E SIMU_routine(void);
+
+// Let time pass: scheduler runs routines due till then, at once on virtual clock
+void SIMU_sleep(uint32_t ms);
@@ -0,0 +1,107 @@
+#pragma once
+
+// Hierarchical timing wheel: WHEEL_LEVELS levels of WHEEL_SLOTS slots, slot of level n spans
+// WHEEL_SLOTS^n ticks. Timer is put in O(1) on level of highest tick digit its expiry differs from
+// wheel time in, and is moved to lower level when wheel time gets to its slot, so it fires at its
+// tick. Timers are intrusive nodes in caller memory, wheel doesn't allocate.
+
+#include "types.h"
+
+#include "mdl_clock.h"
+
+enum {WHEEL_SLOT_BITS = 6u, WHEEL_SLOTS = 1u << WHEEL_SLOT_BITS, WHEEL_LEVELS = 4u};
+
+enum {WHEEL_NOT_PENDING = 0xFFFFu}; // slot of timer which isn't in wheel
+
+typedef struct WHEEL_timer
+{
+    struct WHEEL_timer* next;
+    struct WHEEL_timer* prev;
+    CLOCK_ticks_T expires;
+    uint16_t slot; // level * WHEEL_SLOTS + slot, WHEEL_LEVELS * WHEEL_SLOTS - far list
+} WHEEL_timer_T;
+
+typedef void (*WHEEL_expire_func_T)(WHEEL_timer_T* timer, void* arg);
+
+typedef struct WHEEL
+{
+    CLOCK_ticks_T now; // timers due till now are expired
+    uint32_t pending;
+    uint64_t occupied[WHEEL_LEVELS]; // not empty slots of level
+    WHEEL_timer_T slots[WHEEL_LEVELS * WHEEL_SLOTS + 1u]; // list heads, last one of far timers
+} WHEEL_T;
+
+/*********************************************************************************************************
+ * @brief Init empty wheel.
+ *********************************************************************************************************
+ * @param [out] wheel - Wheel to be inited.
+ * @param [in] now - Current time.
+ * @return Nothing.
+ ********************************************************************************************************/
+void WHEEL_init(WHEEL_T* wheel, CLOCK_ticks_T now);
+
+/*********************************************************************************************************
+ * @brief Init timer node, so it isn't pending.
+ *********************************************************************************************************
+ * @param [out] timer - Timer to be inited.
+ * @return Nothing.
+ ********************************************************************************************************/
+void WHEEL_init_timer(WHEEL_timer_T* timer);
+
+/*********************************************************************************************************
+ * @brief Add timer, O(1). Timer due already expires on next tick.
+ *********************************************************************************************************
+ * @param [in] wheel - Wheel.
+ * @param [in] timer - Timer which isn't pending.
+ * @param [in] expires - Tick to expire at.
+ * @return Nothing.
+ ********************************************************************************************************/
+void WHEEL_add(WHEEL_T* wheel, WHEEL_timer_T* timer, CLOCK_ticks_T expires);
+
+/*********************************************************************************************************
+ * @brief Remove timer before it expires, O(1).
+ *********************************************************************************************************
+ * @param [in] wheel - Wheel.
+ * @param [in] timer - Timer.
+ * @return true if removed, false if timer isn't pending.
+ ********************************************************************************************************/
+bool WHEEL_remove(WHEEL_T* wheel, WHEEL_timer_T* timer);
+
+/*********************************************************************************************************
+ * @brief Check whether timer is in wheel.
+ *********************************************************************************************************
+ * @param [in] timer - Timer.
+ * @return true if timer is pending.
+ ********************************************************************************************************/
+bool WHEEL_is_pending(const WHEEL_timer_T* timer);
+
+/*********************************************************************************************************
+ * @brief Move wheel time to now and expire timers due till then, in order of their ticks. Ticks
+ *        without pending timers are skipped, so cost doesn't grow with time passed.
+ *********************************************************************************************************
+ * @param [in] wheel - Wheel.
+ * @param [in] now - Current time, not earlier than previous one.
+ * @param [in] func - Called for each expired timer, which isn't pending any more. Timers may be
+ *                    added and removed from it.
+ * @param [in] arg - Argument of func.
+ * @return Number of expired timers.
+ ********************************************************************************************************/
+uint32_t WHEEL_advance(WHEEL_T* wheel, CLOCK_ticks_T now, WHEEL_expire_func_T func, void* arg);
+
+/*********************************************************************************************************
+ * @brief Retrieve tick wheel should be advanced at next. It is nearest expiry, or earlier tick at
+ *        which timers of higher level are moved to lower one.
+ *********************************************************************************************************
+ * @param [in] wheel - Wheel.
+ * @param [out] tick - Next tick.
+ * @return true if retrieved, false if no timer is pending.
+ ********************************************************************************************************/
+bool WHEEL_get_next(const WHEEL_T* wheel, CLOCK_ticks_T* tick);
+
+/*********************************************************************************************************
+ * @brief Retrieve number of pending timers.
+ *********************************************************************************************************
+ * @param [in] wheel - Wheel.
+ * @return Number of timers.
+ ********************************************************************************************************/
+uint32_t WHEEL_get_pending(const WHEEL_T* wheel);
@@ -0,0 +1,94 @@
+#pragma once
+
+// Binary tracing: each record keeps format string pointer and raw arguments and is written to
+// lock-free ring of calling thread. Formatting and output are left to TRACE_flush(), called by
+// background thread of TRACE_start() or by application when convenient.
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "types.h"
+
+// Trace levels, macros to be used in #if for compile-time filtering
+#define TRACE_LEVEL_NONE 0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_INFO 2
+#define TRACE_LEVEL_DEBUG 3
+
+// Threads having own ring at a time, records of other threads are dropped
+#ifndef TRACE_MAX_THREADS
+#define TRACE_MAX_THREADS 16u
+#endif
+
+// Records per thread ring, power of 2, records written to full ring are dropped
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 256u
+#endif
+
+enum {TRACE_MAX_ARGS = 6u};
+
+typedef struct TRACE_record
+{
+    uint64_t time_ns; // monotonic time, records of all threads are output in time order
+    const char* fmt;
+    uint32_t level;
+    uint32_t args_number;
+    uint64_t args[TRACE_MAX_ARGS];
+} TRACE_record_T;
+
+// Trace record formatted as printf(fmt, ...) on flush. Arguments are integers and pointers up to
+// TRACE_MAX_ARGS, strings are kept by pointer so they should be literals or live till flush.
+#define TRACE(level, fmt, ...)                            \
+    TRACE_write((level), (fmt), TRACE_NARGS(__VA_ARGS__),     \
+                &((const uint64_t[]){0, TRACE_ARGS(__VA_ARGS__)})[1])
+
+#define TRACE_NARGS(...) TRACE_NARGS_(_, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define TRACE_NARGS_(_, a1, a2, a3, a4, a5, a6, n, ...) n
+
+#define TRACE_ARG(x) (uint64_t)(size_t)(x)
+#define TRACE_ARGS(...) TRACE_CAT(TRACE_ARGS_, TRACE_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define TRACE_ARGS_0()
+#define TRACE_ARGS_1(a) TRACE_ARG(a)
+#define TRACE_ARGS_2(a, b) TRACE_ARG(a), TRACE_ARG(b)
+#define TRACE_ARGS_3(a, b, c) TRACE_ARGS_2(a, b), TRACE_ARG(c)
+#define TRACE_ARGS_4(a, b, c, d) TRACE_ARGS_3(a, b, c), TRACE_ARG(d)
+#define TRACE_ARGS_5(a, b, c, d, e) TRACE_ARGS_4(a, b, c, d), TRACE_ARG(e)
+#define TRACE_ARGS_6(a, b, c, d, e, f) TRACE_ARGS_5(a, b, c, d, e), TRACE_ARG(f)
+#define TRACE_CAT(a, b) TRACE_CAT_(a, b)
+#define TRACE_CAT_(a, b) a##b
+
+/*********************************************************************************************************
+ * @brief Write record to calling thread ring, never blocks. Use TRACE() macro instead.
+ *********************************************************************************************************
+ * @param [in] level - Trace level.
+ * @param [in] fmt - printf format string, literal.
+ * @param [in] args_number - Number of arguments.
+ * @param [in] args - Arguments converted to 64 bits.
+ * @return Nothing.
+ ********************************************************************************************************/
+void TRACE_write(uint32_t level, const char* fmt, uint32_t args_number, const uint64_t* args);
+
+/*********************************************************************************************************
+ * @brief Format records of all threads in time order and write them to stream, one line per record.
+ *        Calls are serialized, can be done from any thread.
+ *********************************************************************************************************
+ * @param [in] stream - Output stream.
+ * @return Number of records written.
+ ********************************************************************************************************/
+uint32_t TRACE_flush(FILE* stream);
+
+/*********************************************************************************************************
+ * @brief Start background thread flushing records to stdout.
+ *********************************************************************************************************
+ * @param [in] period_ms - Flush period.
+ * @return true if started, false if it is running already.
+ ********************************************************************************************************/
+bool TRACE_start(uint32_t period_ms);
+
+/*********************************************************************************************************
+ * @brief Stop background thread and flush remaining records.
+ *********************************************************************************************************
+ * @param [in] Nothing.
+ * @return Nothing.
+ ********************************************************************************************************/
+void TRACE_stop(void);
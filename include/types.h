@@ -5,5 +5,8 @@
 typedef enum { false, true } bool;
 // clang-format on
 
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
+typedef unsigned long long uint64_t;
 #endif
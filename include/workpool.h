@@ -0,0 +1,98 @@
+#pragma once
+
+// Worker pool for splitting one job into independent tasks across cores. Tasks are distributed
+// in contiguous ranges between participants, idle participants steal tasks from the others. Pools
+// are independent, each one is in caller memory, e.g. of board instance it sweeps.
+
+#include "types.h"
+
+#include <pthread.h>
+
+#ifndef MAX_WORKPOOL_WORKERS
+#define MAX_WORKPOOL_WORKERS 16u
+#endif
+
+typedef void (*WORKPOOL_task_T)(uint32_t task_index, void* arg);
+
+// Participant's range of not yet taken tasks: owner takes from front, thieves from back
+typedef struct WORKPOOL_deque
+{
+    pthread_mutex_t lock;
+    uint32_t front;
+    uint32_t back;
+} WORKPOOL_deque_T;
+
+typedef struct WORKPOOL WORKPOOL_T;
+
+// Worker thread, participant 0 is calling thread, 1..workers_number are worker threads
+typedef struct WORKPOOL_worker
+{
+    WORKPOOL_T* pool;
+    pthread_t ptid;
+    uint32_t participant;
+} WORKPOOL_worker_T;
+
+struct WORKPOOL
+{
+    WORKPOOL_worker_T workers[MAX_WORKPOOL_WORKERS];
+    uint32_t workers_number;
+    WORKPOOL_deque_T deques[MAX_WORKPOOL_WORKERS + 1u];
+
+    pthread_mutex_t run_lock; // one job at a time
+    pthread_mutex_t lock;
+    pthread_cond_t job_cond;
+    pthread_cond_t done_cond;
+
+    // current job, guarded by lock
+    WORKPOOL_task_T task;
+    void* arg;
+    uint32_t generation; // incremented for each job
+    uint32_t start_generation; // generation at pool start, workers wait for next one
+    uint32_t busy; // workers still processing current job
+    bool stop;
+};
+
+// Pool without workers, for static and compound literal initialization
+#define WORKPOOL_INITIALIZER                                                                       \
+    {                                                                                              \
+        .run_lock = PTHREAD_MUTEX_INITIALIZER, .lock = PTHREAD_MUTEX_INITIALIZER,                  \
+        .job_cond = PTHREAD_COND_INITIALIZER, .done_cond = PTHREAD_COND_INITIALIZER,               \
+    }
+
+/*********************************************************************************************************
+ * @brief Start worker threads. Repeated call restarts pool with new number of workers.
+ *********************************************************************************************************
+ * @param [in] pool - Pool initialized by WORKPOOL_INITIALIZER.
+ * @param [in] workers_number - Number of worker threads, calling thread participates additionally.
+ * @return true if started, false if workers_number exceeds MAX_WORKPOOL_WORKERS or worker thread
+ *         fails to start, pool is stopped then.
+ ********************************************************************************************************/
+bool WORKPOOL_init(WORKPOOL_T* pool, uint32_t workers_number);
+
+/*********************************************************************************************************
+ * @brief Stop worker threads, pool memory may be released then.
+ *********************************************************************************************************
+ * @param [in] pool - Pool.
+ * @return Nothing.
+ ********************************************************************************************************/
+void WORKPOOL_deinit(WORKPOOL_T* pool);
+
+/*********************************************************************************************************
+ * @brief Retrieve number of worker threads.
+ *********************************************************************************************************
+ * @param [in] pool - Pool.
+ * @return Number of worker threads, 0 if pool is not started.
+ ********************************************************************************************************/
+uint32_t WORKPOOL_get_workers_number(const WORKPOOL_T* pool);
+
+/*********************************************************************************************************
+ * @brief Run job and wait for all its tasks to finish. Each task index is run exactly once, on
+ *        calling thread when pool is not started.
+ *********************************************************************************************************
+ * @param [in] pool - Pool.
+ * @param [in] task - Task function.
+ * @param [in] arg - Argument passed to each task.
+ * @param [in] tasks_number - Number of tasks in job.
+ * @return Nothing.
+ ********************************************************************************************************/
+void WORKPOOL_run(WORKPOOL_T* pool, WORKPOOL_task_T task, void* arg, uint32_t tasks_number);
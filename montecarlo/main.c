@@ -0,0 +1,374 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mdl_clock.h"
+#include "mdl_relay.h"
+#include "simu.h"
+
+// Monte Carlo runner: many simulated boards with their own fault seed, each board is switched back
+// and forth on its own virtual clock and its supervision verdicts are compared with faults injected
+// by simulation. Board is simulated contacts instance (SIMU_ctx_T) supervised by relay instance
+// (RELAY_ctx_T) through its HAL, so boards share nothing. Boards are spread over worker threads,
+// one per CPU core, each running its boards one after another into own aggregate.
+//
+// Usage: mdl_relay_montecarlo [boards] [workers] [seed]
+
+// clang-format off
+enum {
+    RELAYS_NUMBER = MAX_SUPPORTED_RELAYS_NUMBER,
+    ROUNDS = 40U,
+    RESPONSE_MS = 20U,
+    PERIOD_MS = 25U, // between switchings, response time and some stable state
+    LATENCY_BUCKETS = 256U, // 1 ms each, last one counts all longer latencies
+};
+// clang-format on
+
+typedef struct results
+{
+    uint32_t boards;
+    uint64_t actuations;
+    uint64_t faults; // injected by simulation
+    uint64_t detected; // errors reported for relay with simulated fault
+    uint64_t false_positives; // errors reported for relay without simulated fault
+    uint64_t transitions; // OPEN and CLOSE notifications
+    uint64_t latencies[LATENCY_BUCKETS]; // of fault detection
+    uint64_t confirmations[LATENCY_BUCKETS]; // from switching command till OPEN/CLOSE notification
+} results_T;
+
+// Board run by worker thread, listeners get it as arg
+typedef struct board
+{
+    SIMU_ctx_T* simu;
+    void* memory; // of relay instance
+    void* storage; // of relays table
+    results_T* results; // of worker
+    CLOCK_ticks_T switch_time; // of last switching command
+} board_T;
+
+typedef struct worker
+{
+    pthread_t ptid;
+    uint32_t index;
+    uint32_t workers;
+    uint32_t boards;
+    uint64_t seed;
+    bool failed;
+    results_T results;
+} worker_T;
+
+// Board model: delay of normal distribution may exceed response time, giving false positives
+static const SIMU_model_T m_model = {SIMU_delay_NORMAL, 10u, 2u, 3u, 2000u, 2000u};
+
+static RELAY_config_T m_config[RELAYS_NUMBER]; // read only, shared by boards
+
+static void on_state(RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_state_E state, void* arg);
+static void on_error(RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_error_E error, void* arg);
+static bool run_board(board_T* board, uint64_t seed);
+static void* run_worker(void* arg);
+static void merge(results_T* to, const results_T* from);
+static double percentile(const uint64_t* histogram, uint64_t number, double p);
+static void print_histogram(const uint64_t* histogram, uint64_t number);
+static void print(const results_T* results, double elapsed);
+
+int main(int argc, char* argv[])
+{
+    uint32_t boards = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1000u;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t workers =
+        argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : (uint32_t)(cores > 0 ? cores : 1);
+    uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 0) : 1u;
+
+    if (workers == 0) workers = 1;
+    if (workers > boards) workers = boards;
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        m_config[i] = (RELAY_config_T){RELAY_type_NO, (DO_index_E)i, (DI_index_E)i, RESPONSE_MS};
+    }
+
+    printf("boards: %u, relays per board: %u, workers: %u, seed: %llu\n",
+           boards, (uint32_t)RELAYS_NUMBER, workers, (unsigned long long)seed);
+    fflush(stdout);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    worker_T* threads = calloc(workers, sizeof(worker_T));
+    uint32_t started = 0;
+    int ret = EXIT_SUCCESS;
+
+    for (; started < workers; ++started)
+    {
+        worker_T* w = &threads[started];
+
+        *w = (worker_T){.index = started, .workers = workers, .boards = boards, .seed = seed};
+
+        if (pthread_create(&w->ptid, NULL, run_worker, w) != 0)
+        {
+            perror("worker");
+            ret = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    results_T total = {0};
+
+    for (uint32_t i = 0; i < started; ++i)
+    {
+        pthread_join(threads[i].ptid, NULL);
+
+        if (threads[i].failed)
+        {
+            fprintf(stderr, "worker %u failed\n", i);
+            ret = EXIT_FAILURE;
+            continue;
+        }
+
+        merge(&total, &threads[i].results);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    print(&total,
+          (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) * 1e-9);
+
+    free(threads);
+
+    return ret;
+}
+
+void on_state(RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_state_E state, void* arg)
+{
+    (void)ctx;
+    (void)relay_id;
+    (void)state;
+
+    board_T* board = (board_T*)arg;
+    results_T* results = board->results;
+    uint64_t latency_ms =
+        (SIMU_ctx_get_ticks(board->simu) - board->switch_time) / CLOCK_TICKS_PER_MS;
+
+    ++results->transitions;
+    ++results->confirmations[latency_ms < LATENCY_BUCKETS ? latency_ms : LATENCY_BUCKETS - 1u];
+}
+
+void on_error(RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_error_E error, void* arg)
+{
+    (void)ctx;
+    (void)error;
+
+    board_T* board = (board_T*)arg;
+    results_T* results = board->results;
+    SIMU_fault_T fault;
+    SIMU_ctx_get_fault(board->simu, relay_id, &fault);
+
+    if (fault.type == SIMU_fault_NO)
+    {
+        ++results->false_positives;
+        return;
+    }
+
+    // verdict may come before contacts settle, when delay exceeds relay response time
+    CLOCK_ticks_T now = SIMU_ctx_get_ticks(board->simu);
+    uint64_t latency_ms =
+        CLOCK_IS_DUE(fault.since, now) ? (now - fault.since) / CLOCK_TICKS_PER_MS : 0;
+
+    ++results->detected;
+    ++results->latencies[latency_ms < LATENCY_BUCKETS ? latency_ms : LATENCY_BUCKETS - 1u];
+}
+
+bool run_board(board_T* board, uint64_t seed)
+{
+    uint32_t relay_ids[RELAYS_NUMBER];
+    RELAY_listener_id_T id;
+    RELAY_hal_T hal;
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        relay_ids[i] = i;
+    }
+
+    // board time starts from 0 for each board, so board run depends on its seed only
+    SIMU_ctx_set_seed(board->simu, seed);
+    SIMU_ctx_init(board->simu, SIMU_mode_CORRECT, m_config, RELAYS_NUMBER);
+    SIMU_ctx_get_hal(board->simu, &hal);
+
+    RELAY_ctx_T* ctx = RELAY_ctx_create(board->memory, RELAY_ctx_get_size(), &hal);
+
+    if (!RELAY_ctx_init(ctx, m_config, RELAYS_NUMBER, board->storage,
+                        RELAY_get_storage_size(RELAYS_NUMBER)))
+    {
+        return false;
+    }
+
+    RELAY_ctx_set_event_pump(ctx, true);
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        SIMU_ctx_set_model(board->simu, i, &m_model);
+        RELAY_ctx_add_state_listener(ctx, i, on_state, board, &id);
+        RELAY_ctx_add_error_listener(ctx, i, on_error, board, &id);
+    }
+
+    // last rounds have no switching, so faults of last actuation are detected too
+    for (uint32_t round = 0; round < ROUNDS + 2u; ++round)
+    {
+        if (round < ROUNDS)
+        {
+            board->switch_time = SIMU_ctx_get_ticks(board->simu);
+
+            if (round & 1u)
+                RELAY_ctx_open_many(ctx, relay_ids, RELAYS_NUMBER);
+            else
+                RELAY_ctx_close_many(ctx, relay_ids, RELAYS_NUMBER);
+        }
+
+        for (uint32_t t = 0; t < PERIOD_MS; ++t)
+        {
+            SIMU_ctx_advance(board->simu, CLOCK_MS_TO_TICKS(1u));
+            SIMU_ctx_routine(board->simu);
+            RELAY_ctx_routine(ctx);
+
+            while (RELAY_ctx_dispatch_events(ctx, RELAY_EVENT_QUEUE_SIZE) != 0)
+            {
+            }
+        }
+    }
+
+    SIMU_stats_T stats;
+    SIMU_ctx_get_stats(board->simu, &stats);
+
+    board->results->actuations += stats.actuations;
+    board->results->faults += stats.welds + stats.stuck_opens;
+    ++board->results->boards;
+
+    RELAY_ctx_deinit(ctx);
+
+    return true;
+}
+
+void* run_worker(void* arg)
+{
+    worker_T* w = (worker_T*)arg;
+    void* simu_memory = malloc(SIMU_ctx_get_size());
+    board_T board = {
+        .simu = SIMU_ctx_create(simu_memory, SIMU_ctx_get_size()),
+        .memory = malloc(RELAY_ctx_get_size()),
+        .storage = malloc(RELAY_get_storage_size(RELAYS_NUMBER)),
+        .results = &w->results,
+    };
+
+    w->failed = board.simu == NULL || board.memory == NULL || board.storage == NULL;
+
+    // board seeds are 2^32 apart, as relays of board are seeded by consecutive numbers
+    for (uint32_t i = w->index; i < w->boards && !w->failed; i += w->workers)
+    {
+        w->failed = !run_board(&board, w->seed + ((uint64_t)i << 32));
+    }
+
+    free(board.storage);
+    free(board.memory);
+    free(simu_memory);
+
+    return NULL;
+}
+
+void merge(results_T* to, const results_T* from)
+{
+    to->boards += from->boards;
+    to->actuations += from->actuations;
+    to->faults += from->faults;
+    to->detected += from->detected;
+    to->false_positives += from->false_positives;
+    to->transitions += from->transitions;
+
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; ++i)
+    {
+        to->latencies[i] += from->latencies[i];
+        to->confirmations[i] += from->confirmations[i];
+    }
+}
+
+// Latency in ms which p of number counted by histogram do not exceed, p = 1 gives maximal one
+double percentile(const uint64_t* histogram, uint64_t number, double p)
+{
+    uint64_t rank = (uint64_t)(p * (double)(number - 1u));
+    uint64_t count = 0;
+
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; ++i)
+    {
+        count += histogram[i];
+
+        if (count > rank) return i;
+    }
+
+    return LATENCY_BUCKETS - 1u;
+}
+
+// Non-empty buckets with bars scaled to the largest one
+void print_histogram(const uint64_t* histogram, uint64_t number)
+{
+    enum { BAR_WIDTH = 50U };
+    uint64_t max = 0;
+
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; ++i)
+    {
+        if (histogram[i] > max) max = histogram[i];
+    }
+
+    for (uint32_t i = 0; i < LATENCY_BUCKETS && max != 0; ++i)
+    {
+        if (histogram[i] == 0) continue;
+
+        printf("  %3u ms %10llu %5.1f%% ",
+               i, (unsigned long long)histogram[i], 100.0 * histogram[i] / number);
+
+        for (uint64_t bar = histogram[i] * BAR_WIDTH / max; bar != 0; --bar)
+        {
+            putchar('#');
+        }
+
+        putchar('\n');
+    }
+}
+
+void print(const results_T* results, double elapsed)
+{
+    uint64_t relays = (uint64_t)results->boards * RELAYS_NUMBER;
+
+    printf("boards run:        %u in %.2f s (%.1f boards/s)\n",
+           results->boards, elapsed, results->boards / elapsed);
+    printf("actuations:        %llu\n", (unsigned long long)results->actuations);
+    printf("transitions:       %llu (%.2f per relay)\n",
+           (unsigned long long)results->transitions,
+           relays ? (double)results->transitions / relays : 0.0);
+    printf("faults injected:   %llu\n", (unsigned long long)results->faults);
+    printf("faults detected:   %llu (%.2f%%)\n",
+           (unsigned long long)results->detected,
+           results->faults ? 100.0 * results->detected / results->faults : 0.0);
+    printf("false positives:   %llu (%.3f%% of relays)\n",
+           (unsigned long long)results->false_positives,
+           relays ? 100.0 * results->false_positives / relays : 0.0);
+
+    if (results->detected != 0)
+    {
+        printf("detection latency: p50 %.0f ms, p90 %.0f ms, p99 %.0f ms, max %.0f ms\n",
+               percentile(results->latencies, results->detected, 0.5),
+               percentile(results->latencies, results->detected, 0.9),
+               percentile(results->latencies, results->detected, 0.99),
+               percentile(results->latencies, results->detected, 1.0));
+    }
+
+    if (results->transitions != 0)
+    {
+        printf("switch latency:    p50 %.0f ms, p90 %.0f ms, p99 %.0f ms, max %.0f ms\n",
+               percentile(results->confirmations, results->transitions, 0.5),
+               percentile(results->confirmations, results->transitions, 0.9),
+               percentile(results->confirmations, results->transitions, 0.99),
+               percentile(results->confirmations, results->transitions, 1.0));
+        print_histogram(results->confirmations, results->transitions);
+    }
+}
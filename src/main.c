@@ -1,6 +1,5 @@
 #include <stdio.h>
 #include <time.h>
-#include <unistd.h>
 
 #include "mdl_relay.h"
 #include "scheduler.h"
@@ -10,7 +9,8 @@
 enum { RELAYS_NUMBER = 4U };
 typedef enum test_return_ENUM { FAILED, PASSED } test_return_E;
 enum { RESPONCE_5ms = 5U, RESPONCE_10ms = 10U };
-enum { TIME_3s = 3U };
+enum { TIME_100ms = 100U, TIME_3s = 3000U }; // ms
+enum { TRACE_PERIOD_10ms = 10U };
 // clang-format on
 
 static test_return_E not_init_test(void);
@@ -19,6 +19,17 @@ static test_return_E get_state_test(RELAY_config_T* config);
 static test_return_E get_error_test(void);
 static test_return_E open_test(void);
 static test_return_E close_test(void);
+static test_return_E open_many_test(void);
+static test_return_E close_many_test(void);
+static test_return_E open_async_test(void);
+static test_return_E close_async_test(void);
+static test_return_E latch_test(void);
+static test_return_E wait_test(RELAY_state_E state);
+static test_return_E completion_test(void);
+static test_return_E timer_test(void);
+static test_return_E pattern_test(void);
+static test_return_E events_test(void);
+static bool is_in_state(RELAY_state_E state);
 
 int main(int argc, char* argv[])
 {
@@ -27,6 +38,9 @@ int main(int argc, char* argv[])
     (void)argc;
     (void)argv;
 
+    // Log records are output by background thread
+    TRACE_start(TRACE_PERIOD_10ms);
+
     RELAY_config_T relays_config[RELAYS_NUMBER] = {
         {RELAY_type_NO, DO_index_00, DI_index_00, RESPONCE_10ms},
         {RELAY_type_NC, DO_index_01, DI_index_01, RESPONCE_5ms},
@@ -38,6 +52,10 @@ int main(int argc, char* argv[])
     //SIMU_init(SIMU_mode_WRONG, relays_config, RELAYS_NUMBER);
     SIMU_init(SIMU_mode_CORRECT, relays_config, RELAYS_NUMBER);
 
+    // Virtual clock runs simulation without waiting and reproducibly, monotonic one in real time
+    //CLOCK_setSource(CLOCK_source_MONOTONIC);
+    CLOCK_setSource(CLOCK_source_VIRTUAL);
+
     // Test APIs befor init
     LOG(" ");
     LOG("  %s: not_init_test()", not_init_test() == PASSED ? "PASSED" : "FAILED");
@@ -49,6 +67,10 @@ int main(int argc, char* argv[])
     LOG("  %s: add_listeners_test()", add_listeners_test() == PASSED ? "PASSED" : "FAILED");
     LOG(" ");
 
+    // Simulated DI changes are latched before relays routine reads them
+    RELAY_set_change_checks(true);
+    SCHEDULER_routine_id_T simu_id;
+    SCHEDULER_add_routine(SIMU_routine, SCHEDULER_PERIOD_MS, SCHEDULER_PRIORITY_HIGH, &simu_id);
     SCHEDULER_add(RELAY_routine);
     SCHEDULER_run();
 
@@ -59,7 +81,7 @@ int main(int argc, char* argv[])
     LOG("  %s: get_error_test()", get_error_test() == PASSED ? "PASSED" : "FAILED");
     LOG(" ");
 
-    sleep(TIME_3s);
+    SIMU_sleep(TIME_3s);
 
     //
     // Run again init tests after delay, now they should be FAILED in SIMU_mode_WRONG when self
@@ -77,14 +99,75 @@ int main(int argc, char* argv[])
     LOG(" ");
     LOG("  %s: open_test()", open_test() == PASSED ? "PASSED" : "FAILED");
     LOG(" ");
-    sleep(TIME_3s); // to pass relay response time
+    LOG("  %s: wait_test(OPEN)", wait_test(RELAY_state_OPEN) == PASSED ? "PASSED" : "FAILED");
     LOG(" ");
     LOG("  %s: close_test()", close_test() == PASSED ? "PASSED" : "FAILED");
-    sleep(TIME_3s); // to pass relay response time
+    LOG(" ");
+    LOG("  %s: wait_test(CLOSE)", wait_test(RELAY_state_CLOSE) == PASSED ? "PASSED" : "FAILED");
+    LOG(" ");
+
+    //
+    // Batch open and close tests, expect on_state() notifications
+    //
+    LOG(" ");
+    LOG("  %s: open_many_test()", open_many_test() == PASSED ? "PASSED" : "FAILED");
+    SIMU_sleep(TIME_3s); // to pass relay response time
+    LOG(" ");
+    LOG("  %s: close_many_test()", close_many_test() == PASSED ? "PASSED" : "FAILED");
+    SIMU_sleep(TIME_3s); // to pass relay response time
+    LOG(" ");
+
+    //
+    // Async open and close tests, commands are applied by scheduler, expect on_state() notifications
+    //
+    LOG(" ");
+    LOG("  %s: open_async_test()", open_async_test() == PASSED ? "PASSED" : "FAILED");
+    SIMU_sleep(TIME_3s); // to pass relay response time
+    LOG(" ");
+    LOG("  %s: close_async_test()", close_async_test() == PASSED ? "PASSED" : "FAILED");
+    SIMU_sleep(TIME_3s); // to pass relay response time
+    LOG(" ");
+
+    //
+    // Commands during switching are latched and applied after it, expect on_state() notifications
+    // of open and then of close
+    //
+    LOG(" ");
+    LOG("  %s: latch_test()", latch_test() == PASSED ? "PASSED" : "FAILED");
+    LOG(" ");
+
+    //
+    // Each command with completion gets one, expect on_completion() notifications
+    //
+    LOG(" ");
+    LOG("  %s: completion_test()", completion_test() == PASSED ? "PASSED" : "FAILED");
+    LOG(" ");
+
+    //
+    // Scheduled commands fire at their tick, cancelled one doesn't, expect on_state() notifications
+    // of close
+    //
+    LOG(" ");
+    LOG("  %s: timer_test()", timer_test() == PASSED ? "PASSED" : "FAILED");
+    LOG(" ");
+
+    //
+    // Switching patterns run by state machine, expect on_state() notifications of each edge
+    //
+    LOG(" ");
+    LOG("  %s: pattern_test()", pattern_test() == PASSED ? "PASSED" : "FAILED");
+    LOG(" ");
+
+    //
+    // Notifications are delivered by scheduler after each pass, none should be left or dropped
+    //
+    LOG(" ");
+    LOG("  %s: events_test()", events_test() == PASSED ? "PASSED" : "FAILED");
     LOG(" ");
 
     // All done
     RELAY_deinit();
+    SCHEDULER_remove(simu_id);
 
     // Test APIs after deinit
     LOG(" ");
@@ -93,6 +176,8 @@ int main(int argc, char* argv[])
 
     SCHEDULER_wait();
 
+    TRACE_stop();
+
     return 0;
 }
 
@@ -110,6 +195,18 @@ void on_error(uint32_t relay_id, RELAY_error_E error)
     LOG(" ");
 }
 
+// Completions received per relay and result
+static uint32_t m_completions[RELAYS_NUMBER][RELAY_result_CANCELLED + 1u];
+
+void on_completion(uint32_t relay_id, RELAY_result_E result, void* arg)
+{
+    (void)arg;
+
+    LOG("%s(relay_id: %d, result: %d)", __PRETTY_FUNCTION__, relay_id, result);
+
+    ++m_completions[relay_id][result];
+}
+
 test_return_E not_init_test(void)
 {
     LOG("%s()", __PRETTY_FUNCTION__);
@@ -122,11 +219,34 @@ test_return_E not_init_test(void)
     {
         if (RELAY_open(i)) return FAILED;
         if (RELAY_close(i)) return FAILED;
+        if (RELAY_open_async(i)) return FAILED;
+        if (RELAY_close_async(i)) return FAILED;
+        if (RELAY_open_with_completion(i, on_completion, NULL)) return FAILED;
         if (RELAY_get_state(i) != RELAY_state_NOT_INIT) return FAILED;
         if (RELAY_add_state_listener(i, on_state_changed, &state_listener_id)) return FAILED;
         if (RELAY_add_error_listener(i, on_error, &error_listener_id)) return FAILED;
     }
 
+    // config with pins out of board is rejected
+    RELAY_config_T config[] = {
+        {RELAY_type_NO, DO_index_NUMBER, DI_index_00, RESPONCE_10ms},
+        {RELAY_type_NO, DO_index_00, (DI_index_E)(RELAY_WO_FEEDBACK + 1), RESPONCE_10ms},
+    };
+
+    for (uint32_t i = 0; i < sizeof(config) / sizeof(config[0]); ++i)
+    {
+        if (RELAY_init(&config[i], 1u) || RELAY_is_inited()) return FAILED;
+    }
+
+    // storage not aligned as malloc() does is rejected
+    static _Alignas(max_align_t) uint8_t storage[1024];
+    RELAY_config_T valid = {RELAY_type_NO, DO_index_00, DI_index_00, RESPONCE_10ms};
+    size_t storage_size = RELAY_get_storage_size(1u);
+
+    if (storage_size + 1u > sizeof(storage)) return FAILED;
+    if (RELAY_init_with_storage(&valid, 1u, storage + 1u, storage_size)) return FAILED;
+    if (RELAY_is_inited()) return FAILED;
+
     return PASSED;
 }
 
@@ -204,3 +324,258 @@ test_return_E close_test(void)
 
     return PASSED;
 }
+
+test_return_E open_many_test(void)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    uint32_t relay_ids[RELAYS_NUMBER + 1];
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        relay_ids[i] = i;
+    }
+    relay_ids[RELAYS_NUMBER] = RELAYS_NUMBER; // invalid one should be skipped
+
+    if (RELAY_open_many(relay_ids, RELAYS_NUMBER + 1) != RELAYS_NUMBER) return FAILED;
+
+    return PASSED;
+}
+
+test_return_E close_many_test(void)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    uint32_t relay_ids[RELAYS_NUMBER];
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        relay_ids[i] = i;
+    }
+
+    if (RELAY_close_many(relay_ids, RELAYS_NUMBER) != RELAYS_NUMBER) return FAILED;
+
+    return PASSED;
+}
+
+test_return_E open_async_test(void)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    RELAY_queue_stats_T before, after;
+    RELAY_get_queue_stats(&before);
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (!RELAY_open_async(i)) return FAILED;
+    }
+    if (RELAY_open_async(RELAYS_NUMBER)) return FAILED;
+
+    RELAY_get_queue_stats(&after);
+    if (after.accepted - before.accepted != RELAYS_NUMBER) return FAILED;
+    if (after.dropped != before.dropped) return FAILED;
+
+    return PASSED;
+}
+
+test_return_E close_async_test(void)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    RELAY_queue_stats_T stats;
+
+    RELAY_get_queue_stats(&stats);
+    if (stats.depth != 0) return FAILED; // open commands should be applied already
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (!RELAY_close_async(i)) return FAILED;
+    }
+
+    return PASSED;
+}
+
+test_return_E latch_test(void)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    // relays are closed by close_async_test()
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (RELAY_close(i) != RELAY_command_MERGED) return FAILED;
+        if (RELAY_open(i) != RELAY_command_APPLIED) return FAILED;
+        if (RELAY_open(i) != RELAY_command_MERGED) return FAILED;
+        if (RELAY_close(i) != RELAY_command_LATCHED) return FAILED;
+        if (RELAY_close(i) != RELAY_command_MERGED) return FAILED;
+    }
+
+    SIMU_sleep(TIME_3s); // to pass response time of both switchings
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (RELAY_get_state(i) != RELAY_state_CLOSE) return FAILED;
+    }
+
+    return PASSED;
+}
+
+
+test_return_E completion_test(void)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    // relays are closed by latch_test(), latched close is cancelled by last open
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (RELAY_close_with_completion(i, on_completion, NULL) != RELAY_command_MERGED)
+            return FAILED;
+        if (RELAY_open_with_completion(i, on_completion, NULL) != RELAY_command_APPLIED)
+            return FAILED;
+        if (RELAY_close_with_completion(i, on_completion, NULL) != RELAY_command_LATCHED)
+            return FAILED;
+        if (RELAY_open_with_completion(i, on_completion, NULL) != RELAY_command_MERGED)
+            return FAILED;
+    }
+
+    SIMU_sleep(TIME_3s); // to pass relay response time
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (m_completions[i][RELAY_result_OK] != 3u) return FAILED;
+        if (m_completions[i][RELAY_result_CANCELLED] != 1u) return FAILED;
+    }
+
+    return PASSED;
+}
+
+test_return_E timer_test(void)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    RELAY_timer_id_T timer_id;
+
+    // relays are opened by completion_test(), cancelled open doesn't get in the way of close
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (!RELAY_close_after(i, TIME_100ms, NULL)) return FAILED;
+        if (!RELAY_open_after(i, TIME_100ms / 2u, &timer_id)) return FAILED;
+        if (!RELAY_cancel_timer(timer_id)) return FAILED;
+        if (RELAY_cancel_timer(timer_id)) return FAILED;
+    }
+
+    if (RELAY_close_after(RELAYS_NUMBER, TIME_100ms, NULL)) return FAILED;
+    if (RELAY_get_pending_timers() != RELAYS_NUMBER) return FAILED;
+
+    // nothing fires before tick of timers, all of them at it
+    SIMU_sleep(TIME_100ms - 1u);
+    if (RELAY_get_pending_timers() != RELAYS_NUMBER) return FAILED;
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (RELAY_get_state(i) != RELAY_state_OPEN) return FAILED;
+    }
+
+    SIMU_sleep(1u);
+    if (RELAY_get_pending_timers() != 0) return FAILED;
+
+    SIMU_sleep(TIME_3s); // to pass relay response time
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (RELAY_get_state(i) != RELAY_state_CLOSE) return FAILED;
+    }
+
+    return PASSED;
+}
+
+bool is_in_state(RELAY_state_E state)
+{
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (RELAY_get_state(i) != state) return false;
+    }
+
+    return true;
+}
+
+test_return_E pattern_test(void)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    const RELAY_pattern_T pattern = {TIME_100ms, 2u * TIME_100ms, 2u}; // on 0-100, 300-400 ms
+    const RELAY_pattern_T no_off = {TIME_100ms, 0, 0};
+
+    // relays are closed by timer_test(), so first on phase needs no switching
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        if (RELAY_start_pattern(i, &no_off)) return FAILED;
+        if (!RELAY_start_pattern(i, &pattern)) return FAILED;
+    }
+
+    SIMU_sleep(TIME_100ms / 2u); // 50 ms
+    if (!is_in_state(RELAY_state_CLOSE)) return FAILED;
+    SIMU_sleep(TIME_100ms); // 150 ms
+    if (!is_in_state(RELAY_state_OPEN)) return FAILED;
+    SIMU_sleep(2u * TIME_100ms); // 350 ms
+    if (!is_in_state(RELAY_state_CLOSE)) return FAILED;
+    SIMU_sleep(TIME_100ms); // 450 ms, last on phase has ended
+    if (!is_in_state(RELAY_state_OPEN)) return FAILED;
+    if (RELAY_is_pattern_running(0)) return FAILED;
+    SIMU_sleep(TIME_3s);
+    if (!is_in_state(RELAY_state_OPEN)) return FAILED;
+
+    // command takes relay over from pattern, stopped relay stays as it is
+    if (!RELAY_pulse(0, TIME_3s)) return FAILED;
+    if (RELAY_close(0) != RELAY_command_MERGED) return FAILED;
+    if (RELAY_stop_pattern(0)) return FAILED;
+    if (!RELAY_pulse(1, TIME_3s)) return FAILED;
+    if (!RELAY_stop_pattern(1)) return FAILED;
+
+    SIMU_sleep(2u * TIME_3s);
+    if (RELAY_get_state(0) != RELAY_state_CLOSE) return FAILED;
+    if (RELAY_get_state(1) != RELAY_state_CLOSE) return FAILED;
+
+    return PASSED;
+}
+
+// Waits end as soon as switching is confirmed, well before timeout
+test_return_E wait_test(RELAY_state_E state)
+{
+    LOG("%s(state: %d)", __PRETTY_FUNCTION__, state);
+
+    uint32_t relay_ids[RELAYS_NUMBER];
+    RELAY_state_E other = state == RELAY_state_OPEN ? RELAY_state_CLOSE : RELAY_state_OPEN;
+
+    for (uint32_t i = 0; i < RELAYS_NUMBER; ++i)
+    {
+        relay_ids[i] = i;
+    }
+
+    CLOCK_ticks_T start = CLOCK_getTicks();
+
+    if (!RELAY_wait_states(relay_ids, RELAYS_NUMBER, state, RELAY_wait_ANY, TIME_3s)) return FAILED;
+    if (!RELAY_wait_states(relay_ids, RELAYS_NUMBER, state, RELAY_wait_ALL, TIME_3s)) return FAILED;
+    if (CLOCK_IS_DUE(start + CLOCK_MS_TO_TICKS(TIME_3s), CLOCK_getTicks())) return FAILED;
+
+    // state that doesn't come times out, invalid relay fails at once
+    if (RELAY_wait_state(0, other, RESPONCE_5ms)) return FAILED;
+    if (RELAY_wait_state(RELAYS_NUMBER, state, TIME_3s)) return FAILED;
+
+    return PASSED;
+}
+
+test_return_E events_test(void)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    RELAY_queue_stats_T stats;
+
+    RELAY_get_event_stats(&stats);
+    if (stats.depth != 0) return FAILED;
+    if (stats.accepted == 0) return FAILED;
+    if (stats.dropped != 0) return FAILED;
+    if (stats.overflows != 0) return FAILED;
+
+    // queue is drained, nothing left to deliver
+    if (RELAY_dispatch_events(RELAYS_NUMBER) != 0) return FAILED;
+
+    return PASSED;
+}
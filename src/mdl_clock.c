@@ -0,0 +1,67 @@
+#include "mdl_clock.h"
+#include <time.h>
+
+// Linux backend: coarse monotonic clock is read from vDSO without hardware counter access, it is
+// used when its resolution is not worse than one tick
+enum {CLOCK_ID_UNKNOWN = -1};
+
+static uint32_t m_source = CLOCK_source_MONOTONIC; // CLOCK_source_E
+static CLOCK_ticks_T m_virtual_ticks;
+static int m_clock_id = CLOCK_ID_UNKNOWN; // clockid_t of monotonic source
+
+static int select_clock_id(void);
+
+CLOCK_ticks_T CLOCK_getTicks()
+{
+    if (__atomic_load_n(&m_source, __ATOMIC_ACQUIRE) == CLOCK_source_VIRTUAL)
+    {
+        return __atomic_load_n(&m_virtual_ticks, __ATOMIC_ACQUIRE);
+    }
+
+    int clock_id = __atomic_load_n(&m_clock_id, __ATOMIC_RELAXED);
+
+    if (clock_id == CLOCK_ID_UNKNOWN) clock_id = select_clock_id();
+
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+
+    CLOCK_ticks_T ticks = CLOCK_MS_TO_TICKS((CLOCK_ticks_T)ts.tv_sec * 1000u);
+
+    return ticks + (CLOCK_ticks_T)ts.tv_nsec / CLOCK_NS_PER_TICK;
+}
+
+void CLOCK_setSource(CLOCK_source_E source)
+{
+    __atomic_store_n(&m_virtual_ticks, 0u, __ATOMIC_RELEASE);
+    __atomic_store_n(&m_source, (uint32_t)source, __ATOMIC_RELEASE);
+}
+
+CLOCK_source_E CLOCK_getSource(void)
+{
+    return (CLOCK_source_E)__atomic_load_n(&m_source, __ATOMIC_ACQUIRE);
+}
+
+void CLOCK_advance(CLOCK_ticks_T ticks)
+{
+    __atomic_fetch_add(&m_virtual_ticks, ticks, __ATOMIC_ACQ_REL);
+}
+
+// Concurrent first calls select the same clock, so no synchronization is needed
+int select_clock_id(void)
+{
+    int clock_id = CLOCK_MONOTONIC;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+    struct timespec res;
+
+    if (clock_getres(CLOCK_MONOTONIC_COARSE, &res) == 0 && res.tv_sec == 0 &&
+        res.tv_nsec <= (long)CLOCK_NS_PER_TICK)
+    {
+        clock_id = CLOCK_MONOTONIC_COARSE;
+    }
+#endif
+
+    __atomic_store_n(&m_clock_id, clock_id, __ATOMIC_RELAXED);
+
+    return clock_id;
+}
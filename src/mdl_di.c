@@ -0,0 +1,217 @@
+#include "mdl_di.h"
+
+// GPIO backend of DI layer on Linux GPIO character device (uAPI v2, no libgpiod needed). Pins of
+// each port are one line request with edge detection on both edges, watcher thread latches edge
+// events as changes the way interrupt status register does. Board build defines DI_GPIO_BACKEND,
+// simulation (simu.c) provides DI layer otherwise. DI pin n is line DI_GPIO_FIRST_LINE + n of
+// DI_GPIO_CHIP, lines are requested on first DI call.
+#ifdef DI_GPIO_BACKEND
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#ifndef DI_GPIO_CHIP
+#define DI_GPIO_CHIP "/dev/gpiochip0"
+#endif
+
+#ifndef DI_GPIO_FIRST_LINE
+#define DI_GPIO_FIRST_LINE 0u
+#endif
+
+enum {EVENTS_PER_READ = 16u};
+
+static pthread_once_t m_once = PTHREAD_ONCE_INIT;
+static int m_line_fds[DI_PORTS_NUMBER]; // line request of port pins, -1 if it failed
+static DI_mask_T m_changes[DI_PORTS_NUMBER]; // latched for DI_getChanges()
+static int m_change_fds[2] = {-1, -1}; // non-blocking pipe, byte is written on changes
+static DI_change_listener_T m_change_listener;
+
+static void open_lines(void);
+static uint32_t get_port_width(uint32_t port);
+static void* watch_edges(void* arg);
+static bool latch_events(uint32_t port);
+
+DI_state_E DI_getInputState(DI_index_E index)
+{
+    if ((uint32_t)index >= (uint32_t)DI_index_NUMBER) return DI_state_OFF;
+
+    DI_mask_T inputs = DI_getInputs((uint32_t)index / DI_PORT_WIDTH);
+
+    return (inputs >> ((uint32_t)index % DI_PORT_WIDTH)) & 1u ? DI_state_ON : DI_state_OFF;
+}
+
+DI_mask_T DI_getInputs(uint32_t port)
+{
+    pthread_once(&m_once, open_lines);
+
+    if (port >= DI_PORTS_NUMBER || m_line_fds[port] < 0) return 0;
+
+    struct gpio_v2_line_values values = {.bits = 0, .mask = (1ull << get_port_width(port)) - 1u};
+
+    if (ioctl(m_line_fds[port], GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) return 0;
+
+    return (DI_mask_T)values.bits;
+}
+
+DI_mask_T DI_getChanges(uint32_t port)
+{
+    pthread_once(&m_once, open_lines);
+
+    if (port >= DI_PORTS_NUMBER) return 0;
+
+    // fd is drained before changes are taken, change latched after that writes it again
+    if (port == 0 && m_change_fds[0] >= 0)
+    {
+        char bytes[64];
+
+        while (read(m_change_fds[0], bytes, sizeof(bytes)) > 0)
+        {
+        }
+    }
+
+    return __atomic_exchange_n(&m_changes[port], 0, __ATOMIC_ACQ_REL);
+}
+
+int DI_getChangeFd(void)
+{
+    pthread_once(&m_once, open_lines);
+
+    return m_change_fds[0];
+}
+
+void DI_setChangeListener(DI_change_listener_T listener)
+{
+    __atomic_store_n(&m_change_listener, listener, __ATOMIC_RELEASE);
+}
+
+void open_lines(void)
+{
+    int chip = open(DI_GPIO_CHIP, O_RDONLY | O_CLOEXEC);
+    bool opened = false;
+
+    for (uint32_t port = 0; port < DI_PORTS_NUMBER; ++port)
+    {
+        struct gpio_v2_line_request request;
+
+        m_line_fds[port] = -1;
+        if (chip < 0) continue;
+
+        memset(&request, 0, sizeof(request));
+        for (uint32_t i = 0; i < get_port_width(port); ++i)
+        {
+            request.offsets[i] = DI_GPIO_FIRST_LINE + port * DI_PORT_WIDTH + i;
+        }
+        request.num_lines = get_port_width(port);
+        request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING |
+                               GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        strncpy(request.consumer, "mdl_relay", sizeof(request.consumer) - 1u);
+
+        if (ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request) < 0) continue;
+
+        // events are read till queue of request is empty
+        fcntl(request.fd, F_SETFL, O_NONBLOCK);
+        m_line_fds[port] = request.fd;
+        opened = true;
+    }
+
+    if (chip >= 0) close(chip);
+
+    // without watcher changes aren't detected, consumers check all pins on each pass then
+    if (!opened || pipe(m_change_fds) != 0) return;
+
+    for (uint32_t i = 0; i < 2u; ++i)
+    {
+        fcntl(m_change_fds[i], F_SETFL, O_NONBLOCK);
+        fcntl(m_change_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    pthread_t ptid;
+
+    if (pthread_create(&ptid, NULL, watch_edges, NULL) != 0)
+    {
+        close(m_change_fds[0]);
+        close(m_change_fds[1]);
+        m_change_fds[0] = m_change_fds[1] = -1;
+        return;
+    }
+
+    pthread_detach(ptid);
+}
+
+uint32_t get_port_width(uint32_t port)
+{
+    uint32_t begin = port * DI_PORT_WIDTH;
+
+    return DI_index_NUMBER - begin < DI_PORT_WIDTH ? DI_index_NUMBER - begin : DI_PORT_WIDTH;
+}
+
+// Watcher thread runs for process lifetime, as DI layer has no deinit
+void* watch_edges(void* arg)
+{
+    struct pollfd fds[DI_PORTS_NUMBER];
+
+    (void)arg;
+
+    // poll ignores negative fd, so port of failed request is skipped
+    for (uint32_t port = 0; port < DI_PORTS_NUMBER; ++port)
+    {
+        fds[port] = (struct pollfd){.fd = m_line_fds[port], .events = POLLIN};
+    }
+
+    for (;;)
+    {
+        bool changed = false;
+
+        if (poll(fds, DI_PORTS_NUMBER, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (uint32_t port = 0; port < DI_PORTS_NUMBER; ++port)
+        {
+            if (fds[port].revents & POLLIN) changed = latch_events(port) || changed;
+        }
+
+        if (changed)
+        {
+            char byte = 1;
+            DI_change_listener_T listener = __atomic_load_n(&m_change_listener, __ATOMIC_ACQUIRE);
+
+            // write fails when pipe is full only, fd stays readable then
+            (void)!write(m_change_fds[1], &byte, sizeof(byte));
+
+            if (listener != NULL) listener();
+        }
+    }
+
+    return NULL;
+}
+
+bool latch_events(uint32_t port)
+{
+    struct gpio_v2_line_event events[EVENTS_PER_READ];
+    bool latched = false;
+    ssize_t n;
+
+    while ((n = read(m_line_fds[port], events, sizeof(events))) > 0)
+    {
+        for (size_t i = 0; i < (size_t)n / sizeof(events[0]); ++i)
+        {
+            uint32_t bit = events[i].offset - DI_GPIO_FIRST_LINE - port * DI_PORT_WIDTH;
+
+            __atomic_fetch_or(&m_changes[port], (DI_mask_T)1u << bit, __ATOMIC_RELEASE);
+            latched = true;
+        }
+    }
+
+    return latched;
+}
+
+#endif
@@ -1,4 +1,7 @@
 #include "mdl_relay.h"
+#include "mpsc_ring.h"
+#include "timing_wheel.h"
+#include "workpool.h"
 
 //
 // Module types
@@ -32,31 +35,235 @@ typedef enum sm_state_ret_ENUM
     sm_state_ret_DEINIT
 } sm_state_ret_E;
 
+// Listener of instance API, or of compatibility layer without instance and arg when compat is set
+typedef struct state_listener
+{
+    RELAY_ctx_state_listener_func_T func;
+    RELAY_state_listener_func_T compat;
+    void* arg;
+} state_listener_T;
+
+typedef struct error_listener
+{
+    RELAY_ctx_error_listener_func_T func;
+    RELAY_error_listener_func_T compat;
+    void* arg;
+} error_listener_T;
+
 typedef struct state_listeners
 {
-    RELAY_state_listener_func_T funcs[MAX_STATE_LISTENERS_PER_RELAY];
+    state_listener_T items[MAX_STATE_LISTENERS_PER_RELAY];
     uint32_t number;
 } state_listeners_T;
 
 typedef struct error_listeners
 {
-    RELAY_error_listener_func_T funcs[MAX_ERROR_LISTENERS_PER_RELAY];
+    error_listener_T items[MAX_ERROR_LISTENERS_PER_RELAY];
     uint32_t number;
 } error_listeners_T;
 
-typedef struct relay
+typedef struct listeners
+{
+    state_listeners_T state;
+    error_listeners_T error;
+} listeners_T;
+
+// Switching pattern of relay, its edges are given by state machine while FLAG_PATTERN is set
+typedef struct pattern
+{
+    CLOCK_ticks_T next_edge; // open edge in CLOSE state, close edge in OPEN one
+    uint32_t on_ms;
+    uint32_t off_ms;
+    uint32_t remaining; // on phases left, 0 - till stopped
+} pattern_T;
+
+// Bitset of relays indexed by relay_id
+typedef uint64_t bits_T;
+enum {BITS_WIDTH = 64u};
+#define BITS_WORDS(relays_number) (((relays_number) + BITS_WIDTH - 1u) / BITS_WIDTH)
+
+// Relay table as structure of arrays: fields read by each RELAY_routine step are packed in own
+// contiguous arrays, locks and listeners are kept out of line
+typedef struct relays
+{
+    // Whole bank self check: relay is stepped by RELAY_routine only when it is active or its
+    // sampled feedback mismatches expected one
+    uint32_t words; // number of words in each bitset
+    bits_T* has_feedback;
+    bits_T* stable; // OPEN or CLOSE state, feedback is checked
+    bits_T* expected_closed; // CLOSE state
+    bits_T* active; // switching or notification pending, stepped each pass
+
+    uint8_t* sm_state; // sm_state_E
+    uint8_t* flags; // FLAG_FIRE_* | FLAG_SETTLING
+    uint8_t* latched; // event_E commanded during switching, applied when it completes
+    uint16_t* feedback; // DI_index_E copied from config, RELAY_WO_FEEDBACK if none
+    uint16_t* completions; // first of relay commands with completion, or NO_COMPLETION
+    CLOCK_ticks_T* deadline; // start_switch_time + response time of transition in progress
+    CLOCK_ticks_T* settle_time; // feedback confirming transition in progress is stable since then
+    uint32_t* snapshot; // RELAY_state_E and RELAY_error_E published for lock-free readers
+
+    RELAY_LOCK_T* locks;
+    listeners_T* listeners;
+    pattern_T* patterns;
+} relays_T;
+
+// Relay flags: notification pending to be posted, feedback confirms transition, switching pattern
+// is running, pending notification waits for room in full queue
+#define FLAG_FIRE_STATE 0x01u
+#define FLAG_FIRE_ERROR 0x02u
+#define FLAG_SETTLING 0x04u
+#define FLAG_FIRE_COMPLETION 0x08u
+#define FLAG_PATTERN 0x10u
+#define FLAG_OVERFLOW 0x20u
+
+// Relay snapshot packing: RELAY_state_E in low byte, RELAY_error_E in next one
+#define SNAPSHOT_MAKE(state, error) ((uint32_t)(state) | ((uint32_t)(error) << 8))
+#define SNAPSHOT_STATE(snapshot) ((RELAY_state_E)((snapshot)&0xFFu))
+#define SNAPSHOT_ERROR(snapshot) ((RELAY_error_E)(((snapshot) >> 8) & 0xFFu))
+
+// Caller memory should be aligned as malloc() does, arrays placed in it rely on that
+#define IS_MALLOC_ALIGNED(pointer) ((size_t)(pointer) % _Alignof(max_align_t) == 0)
+
+enum {NO_DEADLINE = 0xFFFFFFFFu}; // relay doesn't need step before periodic self check, delay in ms
+enum {NO_COMMAND = 0xFFu}; // no command latched
+enum {NO_COMPLETION = 0xFFFFu, NO_RESULT = 0xFFu};
+enum {NO_TIMER = 0xFFFFu};
+
+// One RELAY_routine pass, shared by shards in parallel mode. Feedback lines are sampled once per
+// pass and all switching verdicts of the pass are given against this sample.
+typedef struct sweep
+{
+    CLOCK_ticks_T now; // sample time
+    DI_mask_T inputs[DI_PORTS_NUMBER + 1u]; // extra port is zero, read for RELAY_WO_FEEDBACK
+    bool full_check; // feedback of all stable relays is checked, otherwise of changed pins only
+    DI_mask_T changes[DI_PORTS_NUMBER + 1u]; // DI pins changed since previous pass
+    bool changed; // some DI pin changed
+    uint32_t delay; // nearest step delay of swept relays
+} sweep_T;
+
+enum {SWEEP_BLOCK_WORDS = 8u}; // bitset words processed at once, lets compiler use SIMD
+
+// Commands of RELAY_open_many/close_many: share one start time, DO writes are collected and issued
+// per port at once
+typedef struct batch
+{
+    RELAY_ctx_T* ctx;
+    CLOCK_ticks_T now;
+    DO_mask_T mask[DO_PORTS_NUMBER];
+    DO_mask_T states[DO_PORTS_NUMBER];
+} batch_T;
+
+// Command submitted by RELAY_open_async/close_async, applied by RELAY_routine
+typedef struct command
+{
+    uint32_t relay_id;
+    uint32_t event; // event_E
+} command_T;
+
+// State or error notification, queued by state machine and delivered to listeners out of locks
+typedef struct notification
 {
-    sm_state_E sm_state;
-    CLOCK_ticks_T start_switch_time;
+    uint32_t relay_id;
+    uint32_t kind; // notification_E
+    uint32_t value; // RELAY_state_E or RELAY_error_E
+} notification_T;
 
-    bool fire_state;
-    bool fire_error;
+typedef enum notification_ENUM
+{
+    notification_STATE,
+    notification_ERROR,
+    notification_COMPLETION, // value is completion index
+} notification_E;
+
+// Command with completion: in relay list till its result is posted, then owned by notification
+// till dispatched, then free
+typedef struct completion
+{
+    RELAY_completion_func_T func; // NULL when free
+    void* arg;
+    uint32_t relay_id;
+    uint16_t next; // of relay list or free list
+    uint8_t event; // event_E commanded
+    uint8_t result; // RELAY_result_E, NO_RESULT till command completes
+} completion_T;
+
+// Scheduled command: pending in wheel till its tick, then applied by RELAY_routine and free
+typedef struct timer
+{
+    WHEEL_timer_T node; // first member, so wheel node is timer
+    uint32_t relay_id;
+    uint16_t next; // of free list
+    uint16_t generation; // of timer id, so id of fired or cancelled timer doesn't match reused one
+    uint8_t event; // event_E
+} timer_T;
+
+// Timer id packing: timer index in low half, generation in high one
+#define TIMER_ID_MAKE(index, generation) ((uint32_t)(index) | ((uint32_t)(generation) << 16))
+#define TIMER_ID_INDEX(timer_id) ((timer_id)&0xFFFFu)
+#define TIMER_ID_GENERATION(timer_id) ((uint16_t)((timer_id) >> 16))
+
+// Outcome of RELAY_ctx_wait_states() check
+typedef enum wait_ENUM
+{
+    wait_PENDING,
+    wait_DONE,
+    wait_FAILED, // relays won't get to state
+} wait_E;
 
-    state_listeners_T state_listeners;
-    error_listeners_T error_listeners;
-} relay_T;
+// Relay board instance: everything RELAY_* functions work on, so boards don't share any state
+struct RELAY_ctx
+{
+    LOCK_T lock; // exclusive for init/deinit, shared for per relay operations
+    bool inited;
+    RELAY_config_T* config;
+    uint32_t relays_number; // 0 when not inited, read lock-free by RELAY_ctx_get_state/error
+    relays_T relays;
+    RELAY_hal_T hal;
+
+    bool parallel; // RELAY_ctx_routine sweeps shards on worker pool
+    WORKPOOL_T pool; // own workers, so boards don't stop or serialize each other
+    RELAY_LOCK_T sweep_lock; // RELAY_ctx_routine passes don't overlap
+    sweep_T sweep; // current RELAY_ctx_routine pass
+    CLOCK_ticks_T self_check_time; // next full check, when board reports DI changes
+
+    // async commands queue
+    MPSC_ring_T queue;
+    _Alignas(max_align_t) uint8_t
+        queue_storage[MPSC_STORAGE_SIZE(RELAY_QUEUE_SIZE, sizeof(command_T))];
+    uint32_t queue_accepted;
+    uint32_t queue_dropped;
+
+    // state and error notifications queue, consumer is serialized by dispatch_lock
+    MPSC_ring_T events;
+    _Alignas(max_align_t) uint8_t
+        events_storage[MPSC_STORAGE_SIZE(RELAY_EVENT_QUEUE_SIZE, sizeof(notification_T))];
+    uint32_t events_accepted;
+    uint32_t events_dropped;
+    uint32_t events_overflows;
+    bool events_full; // post failed, dispatch wakes routine up when it makes room
+    RELAY_LOCK_T dispatch_lock;
+    bool event_pump; // notifications are delivered by RELAY_ctx_dispatch_events() only
+
+    // RELAY_ctx_wait_states() callers, woken when state machine publishes relay state
+    RELAY_LOCK_T wait_lock;
+    RELAY_COND_T wait_cond;
+    bool wait_ready; // wait_cond is initialized, by first init
+    uint32_t waiters;
+
+    // commands with completion, relay lists are changed under relay locks, free list under own
+    completion_T completions[RELAY_COMPLETIONS_NUMBER];
+    uint16_t completions_free;
+    RELAY_LOCK_T completions_lock;
+
+    // scheduled commands, wheel and pool are changed under timers_lock
+    WHEEL_T wheel;
+    timer_T timers[RELAY_TIMERS_NUMBER];
+    uint16_t timers_free;
+    RELAY_LOCK_T timers_lock;
+};
 
-typedef sm_state_ret_E (*state_func_T)(uint32_t relay_id, event_E event);
+typedef sm_state_ret_E (*state_func_T)(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
 
 typedef struct transition
 {
@@ -69,36 +276,156 @@ typedef struct transition
 // Module functions prototypes
 //
 
-static void log_config(void);
-static void notify_error_listeners(uint32_t relay_id, RELAY_error_E error);
-static void notify_state_listeners(uint32_t relay_id, RELAY_state_E state);
-
-static bool is_closed(uint32_t relay_id);
-static void close(uint32_t relay_id);
-static void open(uint32_t relay_id);
-
-static void init_state_machine(uint32_t relay_id);
-static void step_state_machine(uint32_t relay_id, event_E event);
+static bool init(
+    RELAY_ctx_T* ctx, RELAY_config_T* config, uint32_t relays_number, const relays_T* relays);
+static size_t carve_storage(relays_T* relays, uint8_t* storage, uint32_t relays_number);
+static bool is_config_valid(const RELAY_config_T* config, uint32_t relays_number);
+static void log_config(RELAY_ctx_T* ctx, uint32_t relays_number);
+static bool post_fired(RELAY_ctx_T* ctx, uint32_t relay_id);
+static bool post_notification(
+    RELAY_ctx_T* ctx, uint32_t relay_id, notification_E kind, uint32_t value);
+static uint32_t dispatch_notifications(RELAY_ctx_T* ctx, uint32_t max_number);
+static bool add_state_listener(RELAY_ctx_T* ctx,
+                               uint32_t relay_id,
+                               state_listener_T listener,
+                               RELAY_listener_id_T* listener_id);
+static bool add_error_listener(RELAY_ctx_T* ctx,
+                               uint32_t relay_id,
+                               error_listener_T listener,
+                               RELAY_listener_id_T* listener_id);
+static void notify_error_listeners(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_error_E error, const error_listeners_T* listeners);
+static void notify_state_listeners(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_state_E state, const state_listeners_T* listeners);
+
+static wait_E check_states(
+    RELAY_ctx_T* ctx,
+    const uint32_t* relay_ids,
+    uint32_t number,
+    RELAY_state_E state,
+    RELAY_wait_E mode);
+static void wake_waiters(RELAY_ctx_T* ctx);
+
+static bool is_closed(RELAY_ctx_T* ctx, uint32_t relay_id);
+static void close(RELAY_ctx_T* ctx, uint32_t relay_id);
+static void open(RELAY_ctx_T* ctx, uint32_t relay_id);
+static void set_output(RELAY_ctx_T* ctx, uint32_t relay_id, DO_state_E state);
+static CLOCK_ticks_T command_time(RELAY_ctx_T* ctx);
+static bool is_settled(RELAY_ctx_T* ctx, uint32_t relay_id, bool confirms);
+static bool take_pattern_edge(RELAY_ctx_T* ctx, uint32_t relay_id, bool closing);
+static uint32_t command_many(
+    RELAY_ctx_T* ctx, const uint32_t* relay_ids, uint32_t number, event_E event);
+static bool command_async(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static void drain_commands(RELAY_ctx_T* ctx);
+static bool command_at(RELAY_ctx_T* ctx,
+                       uint32_t relay_id,
+                       event_E event,
+                       CLOCK_ticks_T at,
+                       RELAY_timer_id_T* timer_id);
+static void fire_timers(RELAY_ctx_T* ctx);
+static void fire_timer(WHEEL_timer_T* node, void* arg);
+static uint32_t next_timer_delay(RELAY_ctx_T* ctx);
+static uint32_t ticks_to_delay(CLOCK_ticks_T at, CLOCK_ticks_T now);
+static void begin_batch(RELAY_ctx_T* ctx, batch_T* batch);
+static void end_batch(RELAY_ctx_T* ctx, batch_T* batch);
+
+static void init_relay(RELAY_ctx_T* ctx, uint32_t relay_id);
+static void init_state_machine(RELAY_ctx_T* ctx, uint32_t relay_id);
+static void step_state_machine(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static RELAY_command_E apply_command(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static RELAY_command_E command_one(RELAY_ctx_T* ctx,
+                                   uint32_t relay_id,
+                                   event_E event,
+                                   RELAY_completion_func_T func,
+                                   void* arg);
+static uint16_t alloc_completion(RELAY_ctx_T* ctx);
+static void free_completion(RELAY_ctx_T* ctx, uint16_t index);
+static void resolve_completions(
+    RELAY_ctx_T* ctx, uint32_t relay_id, uint8_t event, RELAY_result_E result);
+static void post_completions(RELAY_ctx_T* ctx, uint32_t relay_id);
+static uint32_t take_completions(RELAY_ctx_T* ctx, completion_T* taken);
+static uint32_t next_step_delay(RELAY_ctx_T* ctx, uint32_t relay_id, CLOCK_ticks_T now);
+static void sweep_relays(RELAY_ctx_T* ctx, uint32_t begin, uint32_t end);
+static bits_T sweep_block(RELAY_ctx_T* ctx, uint32_t word, uint32_t words, bits_T* todo);
+static void gather_pins(
+    RELAY_ctx_T* ctx, const DI_mask_T* ports, uint32_t word, uint32_t words, bits_T* bits);
+static void update_bits(RELAY_ctx_T* ctx, uint32_t relay_id);
+static void set_bit(bits_T* bits, uint32_t relay_id, bool value);
+static void sweep_shard(uint32_t shard, void* arg);
+static void sample_inputs(RELAY_ctx_T* ctx);
+static void wakeup(RELAY_ctx_T* ctx, uint32_t delay_ms);
+static CLOCK_ticks_T get_ticks(RELAY_ctx_T* ctx);
 static sm_state_E do_transition(sm_state_E cur_state, sm_state_ret_E state_ret);
-
-static sm_state_ret_E not_init_state(uint32_t relay_id, event_E event);
-static sm_state_ret_E open_state(uint32_t relay_id, event_E event);
-static sm_state_ret_E open_to_close_state(uint32_t relay_id, event_E event);
-static sm_state_ret_E close_state(uint32_t relay_id, event_E event);
-static sm_state_ret_E close_to_open_state(uint32_t relay_id, event_E event);
-static sm_state_ret_E error_const_open_state(uint32_t relay_id, event_E event);
-static sm_state_ret_E error_welded_state(uint32_t relay_id, event_E event);
-static sm_state_ret_E deinit_state(uint32_t relay_id, event_E event);
+static void publish_snapshot(RELAY_ctx_T* ctx, uint32_t relay_id);
+static RELAY_state_E to_relay_state(sm_state_E sm_state);
+static RELAY_error_E to_relay_error(sm_state_E sm_state);
+
+static sm_state_ret_E not_init_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static sm_state_ret_E open_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static sm_state_ret_E open_to_close_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static sm_state_ret_E close_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static sm_state_ret_E close_to_open_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static sm_state_ret_E error_const_open_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static sm_state_ret_E error_welded_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+static sm_state_ret_E deinit_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event);
+
+static DI_mask_T board_get_inputs(void* arg, uint32_t port);
+static DI_mask_T board_get_changes(void* arg, uint32_t port);
+static void board_changed(void);
+static void board_set_outputs(void* arg, uint32_t port, DO_mask_T mask, DO_mask_T states);
+static void board_wakeup(void* arg, uint32_t delay_ms);
 
 //
 // Module variables
 //
 
-LOCK_DEFINE;
-static bool m_inited = false;
-static RELAY_config_T* m_config;
-static uint32_t m_relays_number;
-static relay_T m_relays[MAX_SUPPORTED_RELAYS_NUMBER];
+// Default instance behind RELAY_* functions, bound to board DI/DO and to scheduler
+static RELAY_ctx_T m_default_ctx = {
+    .lock = LOCK_INITIALIZER,
+    .hal = {board_get_inputs, board_set_outputs, NULL, board_wakeup, NULL, NULL},
+    .sweep_lock = RELAY_LOCK_INITIALIZER,
+    .dispatch_lock = RELAY_LOCK_INITIALIZER,
+    .wait_lock = RELAY_LOCK_INITIALIZER,
+    .completions_lock = RELAY_LOCK_INITIALIZER,
+    .timers_lock = RELAY_LOCK_INITIALIZER,
+    .pool = WORKPOOL_INITIALIZER,
+};
+
+// default instance storage for RELAY_init()
+static bits_T m_has_feedback_table[BITS_WORDS(MAX_SUPPORTED_RELAYS_NUMBER)];
+static bits_T m_stable_table[BITS_WORDS(MAX_SUPPORTED_RELAYS_NUMBER)];
+static bits_T m_expected_closed_table[BITS_WORDS(MAX_SUPPORTED_RELAYS_NUMBER)];
+static bits_T m_active_table[BITS_WORDS(MAX_SUPPORTED_RELAYS_NUMBER)];
+static uint8_t m_sm_state_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static uint8_t m_flags_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static uint8_t m_latched_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static uint16_t m_completions_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static uint16_t m_feedback_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static CLOCK_ticks_T m_deadline_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static CLOCK_ticks_T m_settle_time_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static uint32_t m_snapshot_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static RELAY_LOCK_T m_locks_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static listeners_T m_listeners_table[MAX_SUPPORTED_RELAYS_NUMBER];
+static pattern_T m_patterns_table[MAX_SUPPORTED_RELAYS_NUMBER];
+
+static const relays_T m_relays_table = {
+    BITS_WORDS(MAX_SUPPORTED_RELAYS_NUMBER),
+    m_has_feedback_table,
+    m_stable_table,
+    m_expected_closed_table,
+    m_active_table,
+    m_sm_state_table,
+    m_flags_table,
+    m_latched_table,
+    m_feedback_table,
+    m_completions_table,
+    m_deadline_table,
+    m_settle_time_table,
+    m_snapshot_table,
+    m_locks_table,
+    m_listeners_table,
+    m_patterns_table};
+static THREAD_LOCAL batch_T* m_batch; // batch command in progress on calling thread
 
 // should mirror sm_state_ENUM
 static state_func_T m_state_funcs[] = {
@@ -149,548 +476,2382 @@ static const size_t m_state_transitions_size = sizeof(m_state_transitions) / siz
 // Functions implementation
 //
 
-bool RELAY_init(RELAY_config_T* config, uint32_t relays_number)
+size_t RELAY_ctx_get_size(void)
 {
-    LOG("%s()", __PRETTY_FUNCTION__);
+    return sizeof(RELAY_ctx_T);
+}
 
-    bool ret = false;
+RELAY_ctx_T* RELAY_ctx_create(void* memory, size_t memory_size, const RELAY_hal_T* hal)
+{
+    if (memory == NULL || !IS_MALLOC_ALIGNED(memory) || memory_size < sizeof(RELAY_ctx_T) ||
+        hal == NULL)
+    {
+        return NULL;
+    }
 
-    LOCK_INIT;
+    RELAY_ctx_T* ctx = (RELAY_ctx_T*)memory;
 
-    LOCK;
-    if (!m_inited)
-    {
-        m_config = config;
-        m_relays_number = relays_number;
+    *ctx = (RELAY_ctx_T){.hal = *hal, .pool = WORKPOOL_INITIALIZER};
+    LOCK_INIT(ctx->lock);
+    RELAY_LOCK_INIT(ctx->sweep_lock);
+    RELAY_LOCK_INIT(ctx->dispatch_lock);
+    RELAY_LOCK_INIT(ctx->wait_lock);
+    RELAY_LOCK_INIT(ctx->completions_lock);
+    RELAY_LOCK_INIT(ctx->timers_lock);
 
-        log_config();
+    LOG("%s(): %p", __PRETTY_FUNCTION__, ctx);
 
-        for (uint32_t i = 0; i < m_relays_number; ++i)
-        {
-            init_state_machine(i);
-        }
+    return ctx;
+}
 
-        m_inited = true;
-        ret = true;
+RELAY_ctx_T* RELAY_get_default_ctx(void)
+{
+    return &m_default_ctx;
+}
+
+size_t RELAY_get_storage_size(uint32_t relays_number)
+{
+    relays_T relays;
+
+    return carve_storage(&relays, NULL, relays_number);
+}
+
+bool RELAY_ctx_init(
+    RELAY_ctx_T* ctx,
+    RELAY_config_T* config,
+    uint32_t relays_number,
+    void* storage,
+    size_t storage_size)
+{
+    LOG("%s(storage_size: %zu)", __PRETTY_FUNCTION__, storage_size);
+
+    if (storage == NULL || !IS_MALLOC_ALIGNED(storage) ||
+        storage_size < RELAY_get_storage_size(relays_number))
+    {
+        return false;
     }
-    UNLOCK;
 
-    return ret;
+    relays_T relays;
+    carve_storage(&relays, (uint8_t*)storage, relays_number);
+
+    return init(ctx, config, relays_number, &relays);
 }
 
-bool RELAY_is_inited()
+bool RELAY_ctx_is_inited(RELAY_ctx_T* ctx)
 {
     LOG("%s()", __PRETTY_FUNCTION__);
 
-    LOCK;
-    bool inited = m_inited;
-    UNLOCK;
+    LOCK_SHARED(ctx->lock);
+    bool inited = ctx->inited;
+    UNLOCK(ctx->lock);
 
     return inited;
 }
 
-void RELAY_deinit()
+void RELAY_ctx_deinit(RELAY_ctx_T* ctx)
 {
+    completion_T completions[RELAY_COMPLETIONS_NUMBER];
+    uint32_t taken = 0;
+
     LOG("%s()", __PRETTY_FUNCTION__);
 
-    LOCK;
-    if (m_inited)
+    LOCK(ctx->lock);
+    if (ctx->inited)
     {
-        for (uint32_t i = 0; i < m_relays_number; ++i)
+        for (uint32_t i = 0; i < ctx->relays_number; ++i)
         {
             for (;;)
             {
-                step_state_machine(i, event_DEINIT);
+                step_state_machine(ctx, i, event_DEINIT);
 
-                if (m_relays[i].sm_state == sm_state_NOT_INIT) break;
+                if (ctx->relays.sm_state[i] == sm_state_NOT_INIT) break;
             }
         }
-        m_inited = false;
+        ATOMIC_STORE(ctx->relays_number, 0);
+        ctx->inited = false;
+        wake_waiters(ctx);
+
+        // commands not applied till deinit are dropped
+        command_T command;
+        while (MPSC_pop(&ctx->queue, &command))
+        {
+            ATOMIC_ADD(ctx->queue_dropped, 1u);
+        }
+
+        // listeners table is released with module, so not delivered notifications are dropped
+        notification_T notification;
+        while (MPSC_pop(&ctx->events, &notification))
+        {
+            ATOMIC_ADD(ctx->events_dropped, 1u);
+        }
+
+        // completions are caller's, so they are called anyway
+        taken = take_completions(ctx, completions);
+    }
+
+    // workers are stopped with instance, so its memory may be released after deinit
+    WORKPOOL_deinit(&ctx->pool);
+    ctx->parallel = false;
+    UNLOCK(ctx->lock);
+
+    for (uint32_t i = 0; i < taken; ++i)
+    {
+        completions[i].func(
+            completions[i].relay_id, (RELAY_result_E)completions[i].result, completions[i].arg);
     }
-    UNLOCK;
 }
 
-SCHEDULER_routine_state_E RELAY_routine(void)
+SCHEDULER_routine_state_E RELAY_ctx_routine(RELAY_ctx_T* ctx)
 {
     SCHEDULER_routine_state_E ret = SCHEDULER_NOTHING_TODO;
+    bool dispatch = false;
 
-    LOCK;
-    if (m_inited)
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited)
     {
-        for (uint32_t i = 0; i < m_relays_number; ++i)
+        RELAY_LOCK(ctx->sweep_lock);
+
+        fire_timers(ctx);
+        drain_commands(ctx);
+        sample_inputs(ctx);
+
+        if (ctx->parallel)
         {
-            step_state_machine(i, event_SELF_CHECK);
+            uint32_t shards = (ctx->relays_number + RELAY_SHARD_SIZE - 1u) / RELAY_SHARD_SIZE;
+
+            WORKPOOL_run(&ctx->pool, sweep_shard, ctx, shards);
         }
+        else
+            sweep_relays(ctx, 0, ctx->relays_number);
+
+        // sleep till nearest switching deadline or timer instead of full scheduler period
+        uint32_t delay = next_timer_delay(ctx);
+
+        if (ctx->sweep.delay < delay) delay = ctx->sweep.delay;
+        if (delay != NO_DEADLINE) wakeup(ctx, delay);
 
+        RELAY_UNLOCK(ctx->sweep_lock);
+
+        dispatch = !ctx->event_pump;
         ret = SCHEDULER_ACTIVE;
     }
-    UNLOCK;
+    UNLOCK(ctx->lock);
+
+    // listeners are called out of locks, one queue capacity per pass bounds pass duration
+    if (dispatch) dispatch_notifications(ctx, RELAY_EVENT_QUEUE_SIZE);
 
-    LOG("%s(): %d", __PRETTY_FUNCTION__, ret);
+    LOG_DEBUG("%s(): %d", __PRETTY_FUNCTION__, ret);
 
     return ret;
 }
 
-bool RELAY_open(uint32_t relay_id)
+bool RELAY_ctx_set_workers(RELAY_ctx_T* ctx, uint32_t workers_number)
 {
     bool ret = false;
 
-    LOCK;
-    if (m_inited)
+    LOCK(ctx->lock);
+    if (workers_number == 0)
     {
-        step_state_machine(relay_id, event_OPEN);
+        WORKPOOL_deinit(&ctx->pool);
+        ctx->parallel = false;
         ret = true;
     }
-    UNLOCK;
+    else
+    {
+        ret = WORKPOOL_init(&ctx->pool, workers_number);
+
+        // failed start stops pool, workers_number over limit keeps running one
+        ctx->parallel = WORKPOOL_get_workers_number(&ctx->pool) != 0;
+    }
+    UNLOCK(ctx->lock);
 
-    LOG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
+    LOG("%s(workers_number: %d): %d", __PRETTY_FUNCTION__, workers_number, ret);
 
     return ret;
 }
 
-bool RELAY_close(uint32_t relay_id)
+RELAY_command_E RELAY_ctx_open(RELAY_ctx_T* ctx, uint32_t relay_id)
 {
-    bool ret = false;
-
-    LOCK;
-    if (m_inited)
-    {
-        step_state_machine(relay_id, event_CLOSE);
-        ret = true;
-    }
-    UNLOCK;
+    RELAY_command_E ret = command_one(ctx, relay_id, event_OPEN, NULL, NULL);
 
     LOG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
     return ret;
 }
 
-RELAY_state_E RELAY_get_state(uint32_t relay_id)
+RELAY_command_E RELAY_ctx_close(RELAY_ctx_T* ctx, uint32_t relay_id)
 {
-    RELAY_state_E ret = RELAY_state_NOT_INIT;
-
-    LOCK;
-    if (m_inited)
-    {
-        switch (m_relays[relay_id].sm_state)
-        {
-        case sm_state_NOT_INIT:
-        default:
-            ret = RELAY_state_NOT_INIT;
-            break;
-
-        case sm_state_OPEN:
-        case sm_state_OPEN_TO_CLOSE: // fine question, can be clarified
-        case sm_state_ERROR_CONST_OPEN:
-            ret = RELAY_state_OPEN;
-            break;
-
-        case sm_state_CLOSE:
-        case sm_state_CLOSE_TO_OPEN: // fine question, can be clarified
-        case sm_state_ERROR_WELDED:
-            ret = RELAY_state_CLOSE;
-            break;
-        }
-    }
-    UNLOCK;
+    RELAY_command_E ret = command_one(ctx, relay_id, event_CLOSE, NULL, NULL);
 
     LOG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
     return ret;
 }
 
-RELAY_error_E RELAY_get_error(uint32_t relay_id)
+RELAY_command_E RELAY_ctx_open_with_completion(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_completion_func_T func, void* arg)
 {
-    RELAY_error_E ret = RELAY_error_NO;
+    RELAY_command_E ret =
+        func != NULL ? command_one(ctx, relay_id, event_OPEN, func, arg) : RELAY_command_REJECTED;
 
-    LOCK;
-    if (m_inited)
-    {
-        switch (m_relays[relay_id].sm_state)
-        {
-        case sm_state_NOT_INIT:
-        case sm_state_OPEN:
-        case sm_state_OPEN_TO_CLOSE:
-        case sm_state_CLOSE:
-        case sm_state_CLOSE_TO_OPEN:
-        default:
-            ret = RELAY_error_NO;
-            break;
+    LOG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
-        case sm_state_ERROR_CONST_OPEN:
-            ret = RELAY_error_CONSTANTLY_OPEN;
-            break;
+    return ret;
+}
 
-        case sm_state_ERROR_WELDED:
-            ret = RELAY_error_WELDED;
-            break;
-        }
-    }
-    UNLOCK;
+RELAY_command_E RELAY_ctx_close_with_completion(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_completion_func_T func, void* arg)
+{
+    RELAY_command_E ret =
+        func != NULL ? command_one(ctx, relay_id, event_CLOSE, func, arg) : RELAY_command_REJECTED;
 
     LOG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
     return ret;
 }
 
-bool RELAY_add_state_listener(uint32_t relay_id, RELAY_state_listener_func_T func, RELAY_listener_id_T* listener_id)
+uint32_t RELAY_ctx_open_many(RELAY_ctx_T* ctx, const uint32_t* relay_ids, uint32_t number)
 {
-    bool ret = false;
-
-    LOCK;
-    if (m_inited)
-    {
-        uint32_t* n = &m_relays[relay_id].state_listeners.number;
-
-        if (*n < MAX_STATE_LISTENERS_PER_RELAY)
-        {
-            m_relays[relay_id].state_listeners.funcs[*n] = func;
-            *listener_id = *n;
-            ++*n;
-            ret = true;
-        }
-    }
-    UNLOCK;
+    uint32_t ret = command_many(ctx, relay_ids, number, event_OPEN);
 
-    LOG("%s(relay_id: %d, listener_id: %d): %d", __PRETTY_FUNCTION__, relay_id, *listener_id, ret);
+    LOG("%s(number: %d): %d", __PRETTY_FUNCTION__, number, ret);
 
     return ret;
 }
 
-bool RELAY_add_error_listener(uint32_t relay_id, RELAY_error_listener_func_T func, RELAY_listener_id_T* listener_id)
+uint32_t RELAY_ctx_close_many(RELAY_ctx_T* ctx, const uint32_t* relay_ids, uint32_t number)
 {
-    bool ret = false;
-
-    LOCK;
-    if (m_inited)
-    {
-        uint32_t* n = &m_relays[relay_id].error_listeners.number;
-
-        if (*n < MAX_ERROR_LISTENERS_PER_RELAY)
-        {
-            m_relays[relay_id].error_listeners.funcs[*n] = func;
-            *listener_id = *n;
-            ++*n;
-            ret = true;
-        }
-    }
-    UNLOCK;
+    uint32_t ret = command_many(ctx, relay_ids, number, event_CLOSE);
 
-    LOG("%s(relay_id: %d, listener_id: %d): %d", __PRETTY_FUNCTION__, relay_id, *listener_id, ret);
+    LOG("%s(number: %d): %d", __PRETTY_FUNCTION__, number, ret);
 
     return ret;
 }
 
-void init_state_machine(uint32_t relay_id)
+bool RELAY_ctx_open_async(RELAY_ctx_T* ctx, uint32_t relay_id)
 {
-    LOG("%s(relay_id: %d)", __PRETTY_FUNCTION__, relay_id);
+    return command_async(ctx, relay_id, event_OPEN);
+}
 
-    if (m_config[relay_id].type == RELAY_type_NO)
-    {
-        m_relays[relay_id].sm_state = sm_state_OPEN;
-    }
-    else
-        m_relays[relay_id].sm_state = sm_state_CLOSE;
+bool RELAY_ctx_close_async(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    return command_async(ctx, relay_id, event_CLOSE);
 }
 
-void step_state_machine(uint32_t relay_id, event_E event)
+bool RELAY_ctx_open_at(
+    RELAY_ctx_T* ctx, uint32_t relay_id, CLOCK_ticks_T at, RELAY_timer_id_T* timer_id)
 {
-    sm_state_E cur_state = m_relays[relay_id].sm_state;
+    bool ret = command_at(ctx, relay_id, event_OPEN, at, timer_id);
 
-    sm_state_ret_E ret = m_state_funcs[cur_state](relay_id, event);
+    LOG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
-    m_relays[relay_id].sm_state = do_transition(cur_state, ret);
+    return ret;
 }
 
-sm_state_ret_E not_init_state(uint32_t relay_id, event_E event)
+bool RELAY_ctx_close_at(
+    RELAY_ctx_T* ctx, uint32_t relay_id, CLOCK_ticks_T at, RELAY_timer_id_T* timer_id)
 {
-    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+    bool ret = command_at(ctx, relay_id, event_CLOSE, at, timer_id);
 
-    LOG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+    LOG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
     return ret;
 }
 
-sm_state_ret_E open_state(uint32_t relay_id, event_E event)
+bool RELAY_ctx_open_after(
+    RELAY_ctx_T* ctx, uint32_t relay_id, uint32_t delay_ms, RELAY_timer_id_T* timer_id)
 {
-    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+    return RELAY_ctx_open_at(
+        ctx, relay_id, get_ticks(ctx) + CLOCK_MS_TO_TICKS(delay_ms), timer_id);
+}
 
-    if (m_relays[relay_id].fire_state)
-    {
-        m_relays[relay_id].fire_state = false;
-        notify_state_listeners(relay_id, RELAY_state_OPEN);
-    }
+bool RELAY_ctx_close_after(
+    RELAY_ctx_T* ctx, uint32_t relay_id, uint32_t delay_ms, RELAY_timer_id_T* timer_id)
+{
+    return RELAY_ctx_close_at(
+        ctx, relay_id, get_ticks(ctx) + CLOCK_MS_TO_TICKS(delay_ms), timer_id);
+}
 
-    switch (event)
-    {
-    case event_OPEN:
-    default:
-        ret = sm_state_ret_NO_TRANSITION;
-        break;
+bool RELAY_ctx_cancel_timer(RELAY_ctx_T* ctx, RELAY_timer_id_T timer_id)
+{
+    bool ret = false;
+    uint32_t index = TIMER_ID_INDEX(timer_id);
 
-    case event_CLOSE:
-        close(relay_id);
-        m_relays[relay_id].start_switch_time = CLOCK_getTicks();
-        ret = sm_state_ret_OK;
-        break;
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited && index < RELAY_TIMERS_NUMBER)
+    {
+        timer_T* timer = &ctx->timers[index];
 
-    case event_SELF_CHECK:
-        if (m_config[relay_id].feedback_index != RELAY_WO_FEEDBACK && is_closed(relay_id))
+        RELAY_LOCK(ctx->timers_lock);
+        if (timer->generation == TIMER_ID_GENERATION(timer_id) &&
+            WHEEL_remove(&ctx->wheel, &timer->node))
         {
-            m_relays[relay_id].fire_error = true;
-            ret = sm_state_ret_NOK;
+            timer->next = ctx->timers_free;
+            ctx->timers_free = (uint16_t)index;
+            ret = true;
         }
-        break;
-
-    case event_DEINIT:
-        ret = sm_state_ret_DEINIT;
-        break;
+        RELAY_UNLOCK(ctx->timers_lock);
     }
+    UNLOCK(ctx->lock);
 
-    LOG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+    LOG("%s(timer_id: %d): %d", __PRETTY_FUNCTION__, timer_id, ret);
 
     return ret;
 }
 
-sm_state_ret_E open_to_close_state(uint32_t relay_id, event_E event)
+uint32_t RELAY_ctx_get_pending_timers(RELAY_ctx_T* ctx)
 {
-    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+    uint32_t ret = 0;
 
-    if (event == event_DEINIT)
-        ret = sm_state_ret_DEINIT;
-    else
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited)
     {
-        if (m_relays[relay_id].start_switch_time + m_config[relay_id].response_ms > CLOCK_getTicks())
-        {
-            ret = sm_state_ret_NO_TRANSITION; // still wait
-        }
-        else
-        {
-            if (m_config[relay_id].feedback_index == RELAY_WO_FEEDBACK)
-            {
-                m_relays[relay_id].fire_state = true;
-                ret = sm_state_ret_OK;
-            }
-            else
-            {
-                if (is_closed(relay_id))
-                {
-                    m_relays[relay_id].fire_state = true;
-                    ret = sm_state_ret_OK;
-                }
-                else
-                {
-                    m_relays[relay_id].fire_error = true;
-                    ret = sm_state_ret_NOK;
-                }
-            }
-        }
+        RELAY_LOCK(ctx->timers_lock);
+        ret = WHEEL_get_pending(&ctx->wheel);
+        RELAY_UNLOCK(ctx->timers_lock);
     }
-
-    LOG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+    UNLOCK(ctx->lock);
 
     return ret;
 }
 
-sm_state_ret_E close_state(uint32_t relay_id, event_E event)
+bool RELAY_ctx_start_pattern(RELAY_ctx_T* ctx, uint32_t relay_id, const RELAY_pattern_T* pattern)
 {
-    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+    bool ret = false;
 
-    if (m_relays[relay_id].fire_state)
-    {
-        m_relays[relay_id].fire_state = false;
-        notify_state_listeners(relay_id, RELAY_state_CLOSE);
-    }
+    // open phase is needed between on phases
+    bool valid = pattern != NULL && pattern->on_ms != 0 &&
+                 (pattern->off_ms != 0 || pattern->count == 1u);
 
-    switch (event)
+    LOCK_SHARED(ctx->lock);
+    if (valid && ctx->inited && relay_id < ctx->relays_number)
     {
-    case event_OPEN:
-        open(relay_id);
-        m_relays[relay_id].start_switch_time = CLOCK_getTicks();
-        ret = sm_state_ret_OK;
-        break;
-
-    case event_CLOSE:
-    default:
-        ret = sm_state_ret_NO_TRANSITION;
-        break;
+        RELAY_LOCK(ctx->relays.locks[relay_id]);
 
-    case event_SELF_CHECK:
-        if (m_config[relay_id].feedback_index != RELAY_WO_FEEDBACK && !is_closed(relay_id))
+        // first on phase starts now, even when relay was closed or switching already
+        if (apply_command(ctx, relay_id, event_CLOSE) != RELAY_command_REJECTED)
         {
-            m_relays[relay_id].fire_error = true;
-            ret = sm_state_ret_NOK;
-        }
-        break;
+            pattern_T* p = &ctx->relays.patterns[relay_id];
 
-    case event_DEINIT:
-        ret = sm_state_ret_DEINIT;
-        break;
+            p->on_ms = pattern->on_ms;
+            p->off_ms = pattern->off_ms;
+            p->remaining = pattern->count;
+            p->next_edge = command_time(ctx) + CLOCK_MS_TO_TICKS(pattern->on_ms);
+
+            ctx->relays.flags[relay_id] |= FLAG_PATTERN;
+            update_bits(ctx, relay_id);
+            ret = true;
+        }
+        RELAY_UNLOCK(ctx->relays.locks[relay_id]);
     }
+    UNLOCK(ctx->lock);
 
-    LOG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+    if (ret) wakeup(ctx, 0);
+
+    LOG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
     return ret;
 }
 
-sm_state_ret_E close_to_open_state(uint32_t relay_id, event_E event)
+bool RELAY_ctx_pulse(RELAY_ctx_T* ctx, uint32_t relay_id, uint32_t on_ms)
 {
-    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+    RELAY_pattern_T pattern = {on_ms, 0, 1u};
 
-    if (event == event_DEINIT)
-        ret = sm_state_ret_DEINIT;
-    else
+    return RELAY_ctx_start_pattern(ctx, relay_id, &pattern);
+}
+
+bool RELAY_ctx_stop_pattern(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    bool ret = false;
+
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited && relay_id < ctx->relays_number)
     {
-        if (m_relays[relay_id].start_switch_time + m_config[relay_id].response_ms > CLOCK_getTicks())
-        {
-            ret = sm_state_ret_NO_TRANSITION; // still wait
-        }
-        else
-        {
-            if (m_config[relay_id].feedback_index == RELAY_WO_FEEDBACK)
-            {
-                m_relays[relay_id].fire_state = true;
-                ret = sm_state_ret_OK;
-            }
-            else
-            {
-                if (!is_closed(relay_id))
-                {
-                    m_relays[relay_id].fire_state = true;
-                    ret = sm_state_ret_OK;
-                }
-                else
-                {
-                    m_relays[relay_id].fire_error = true;
-                    ret = sm_state_ret_NOK;
-                }
-            }
-        }
+        RELAY_LOCK(ctx->relays.locks[relay_id]);
+        ret = (ctx->relays.flags[relay_id] & FLAG_PATTERN) != 0;
+        ctx->relays.flags[relay_id] &= (uint8_t)~FLAG_PATTERN;
+        update_bits(ctx, relay_id);
+        RELAY_UNLOCK(ctx->relays.locks[relay_id]);
     }
+    UNLOCK(ctx->lock);
 
-    LOG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+    LOG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
     return ret;
 }
 
-sm_state_ret_E error_const_open_state(uint32_t relay_id, event_E event)
+bool RELAY_ctx_is_pattern_running(RELAY_ctx_T* ctx, uint32_t relay_id)
 {
-    (void)event;
-
-    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+    bool ret = false;
 
-    if (m_relays[relay_id].fire_error)
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited && relay_id < ctx->relays_number)
     {
-        m_relays[relay_id].fire_error = false;
-        notify_error_listeners(relay_id, RELAY_error_CONSTANTLY_OPEN);
+        RELAY_LOCK(ctx->relays.locks[relay_id]);
+        ret = (ctx->relays.flags[relay_id] & FLAG_PATTERN) != 0;
+        RELAY_UNLOCK(ctx->relays.locks[relay_id]);
     }
+    UNLOCK(ctx->lock);
 
-    if (event == event_DEINIT) ret = sm_state_ret_DEINIT;
-
-    LOG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+    LOG_DEBUG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
     return ret;
 }
 
-sm_state_ret_E error_welded_state(uint32_t relay_id, event_E event)
+void RELAY_ctx_get_queue_stats(RELAY_ctx_T* ctx, RELAY_queue_stats_T* stats)
 {
-    (void)event;
+    stats->depth = MPSC_get_depth(&ctx->queue);
+    stats->accepted = ATOMIC_LOAD(ctx->queue_accepted);
+    stats->dropped = ATOMIC_LOAD(ctx->queue_dropped);
+    stats->overflows = 0;
+}
 
-    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+bool RELAY_ctx_set_event_pump(RELAY_ctx_T* ctx, bool enabled)
+{
+    LOCK(ctx->lock);
+    ctx->event_pump = enabled;
+    UNLOCK(ctx->lock);
+
+    LOG("%s(enabled: %d): %d", __PRETTY_FUNCTION__, enabled, true);
+
+    return true;
+}
+
+uint32_t RELAY_ctx_dispatch_events(RELAY_ctx_T* ctx, uint32_t max_events)
+{
+    return dispatch_notifications(ctx, max_events);
+}
+
+void RELAY_ctx_get_event_stats(RELAY_ctx_T* ctx, RELAY_queue_stats_T* stats)
+{
+    stats->depth = MPSC_get_depth(&ctx->events);
+    stats->accepted = ATOMIC_LOAD(ctx->events_accepted);
+    stats->dropped = ATOMIC_LOAD(ctx->events_dropped);
+    stats->overflows = ATOMIC_LOAD(ctx->events_overflows);
+}
+
+bool RELAY_ctx_wait_state(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_state_E state, uint32_t timeout_ms)
+{
+    return RELAY_ctx_wait_states(ctx, &relay_id, 1u, state, RELAY_wait_ALL, timeout_ms);
+}
+
+bool RELAY_ctx_wait_states(
+    RELAY_ctx_T* ctx,
+    const uint32_t* relay_ids,
+    uint32_t number,
+    RELAY_state_E state,
+    RELAY_wait_E mode,
+    uint32_t timeout_ms)
+{
+    wait_E ret = wait_FAILED;
+    RELAY_DEADLINE_T deadline;
+
+    RELAY_DEADLINE_SET(deadline, timeout_ms);
 
-    if (m_relays[relay_id].fire_error)
+    // wait_cond is initialized by first init, waiting on instance never inited fails at once
+    LOCK_SHARED(ctx->lock);
+    bool ready = ctx->wait_ready;
+    UNLOCK(ctx->lock);
+
+    if (ready)
     {
-        m_relays[relay_id].fire_error = false;
-        notify_error_listeners(relay_id, RELAY_error_WELDED);
+        RELAY_LOCK(ctx->wait_lock);
+        ATOMIC_ADD(ctx->waiters, 1u);
+        ATOMIC_FENCE(); // pairs with wake_waiters(): state published after check wakes waiter up
+
+        while ((ret = check_states(ctx, relay_ids, number, state, mode)) == wait_PENDING)
+        {
+            if (!RELAY_COND_WAIT(ctx->wait_cond, ctx->wait_lock, deadline))
+            {
+                ret = check_states(ctx, relay_ids, number, state, mode);
+                break;
+            }
+        }
+
+        ATOMIC_ADD(ctx->waiters, (uint32_t)-1);
+        RELAY_UNLOCK(ctx->wait_lock);
     }
 
-    if (event == event_DEINIT) ret = sm_state_ret_DEINIT;
+    LOG("%s(number: %d, state: %d, mode: %d, timeout_ms: %d): %d",
+        __PRETTY_FUNCTION__, number, state, mode, timeout_ms, ret == wait_DONE);
+
+    return ret == wait_DONE;
+}
+
+RELAY_state_E RELAY_ctx_get_state(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    RELAY_state_E ret = RELAY_state_NOT_INIT;
+
+    // lock-free: snapshot is published by state machine on each step
+    if (relay_id < ATOMIC_LOAD(ctx->relays_number))
+    {
+        uint32_t* snapshot = ATOMIC_LOAD(ctx->relays.snapshot);
+        ret = SNAPSHOT_STATE(ATOMIC_LOAD(snapshot[relay_id]));
+    }
 
-    LOG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+    LOG_DEBUG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
     return ret;
 }
 
-static sm_state_ret_E deinit_state(uint32_t relay_id, event_E event)
+RELAY_error_E RELAY_ctx_get_error(RELAY_ctx_T* ctx, uint32_t relay_id)
 {
-    sm_state_ret_E ret = sm_state_ret_OK;
+    RELAY_error_E ret = RELAY_error_NO;
 
-    if(m_config[relay_id].type == RELAY_type_NO)
-        open(relay_id);
-    else close(relay_id);
+    // lock-free: snapshot is published by state machine on each step
+    if (relay_id < ATOMIC_LOAD(ctx->relays_number))
+    {
+        uint32_t* snapshot = ATOMIC_LOAD(ctx->relays.snapshot);
+        ret = SNAPSHOT_ERROR(ATOMIC_LOAD(snapshot[relay_id]));
+    }
 
-    LOG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+    LOG_DEBUG("%s(relay_id: %d): %d", __PRETTY_FUNCTION__, relay_id, ret);
 
     return ret;
 }
 
-sm_state_E do_transition(sm_state_E cur_state, sm_state_ret_E state_ret)
+bool RELAY_ctx_add_state_listener(
+    RELAY_ctx_T* ctx,
+    uint32_t relay_id,
+    RELAY_ctx_state_listener_func_T func,
+    void* arg,
+    RELAY_listener_id_T* listener_id)
 {
-    for (size_t i = 0; i < m_state_transitions_size; ++i)
+    return add_state_listener(ctx, relay_id, (state_listener_T){func, NULL, arg}, listener_id);
+}
+
+bool RELAY_ctx_add_error_listener(
+    RELAY_ctx_T* ctx,
+    uint32_t relay_id,
+    RELAY_ctx_error_listener_func_T func,
+    void* arg,
+    RELAY_listener_id_T* listener_id)
+{
+    return add_error_listener(ctx, relay_id, (error_listener_T){func, NULL, arg}, listener_id);
+}
+
+bool add_state_listener(RELAY_ctx_T* ctx,
+                        uint32_t relay_id,
+                        state_listener_T listener,
+                        RELAY_listener_id_T* listener_id)
+{
+    bool ret = false;
+
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited && relay_id < ctx->relays_number)
     {
-        if (m_state_transitions[i].src_state == cur_state &&
-            m_state_transitions[i].ret_code == state_ret)
+        RELAY_LOCK(ctx->relays.locks[relay_id]);
+
+        uint32_t* n = &ctx->relays.listeners[relay_id].state.number;
+
+        if (*n < MAX_STATE_LISTENERS_PER_RELAY)
         {
-            return m_state_transitions[i].dst_state;
+            ctx->relays.listeners[relay_id].state.items[*n] = listener;
+            *listener_id = *n;
+            ++*n;
+            ret = true;
         }
+
+        RELAY_UNLOCK(ctx->relays.locks[relay_id]);
     }
+    UNLOCK(ctx->lock);
 
-    return cur_state;
+    LOG("%s(relay_id: %d, listener_id: %d): %d", __PRETTY_FUNCTION__, relay_id, *listener_id, ret);
+
+    return ret;
 }
 
-static void close(uint32_t relay_id)
+bool add_error_listener(RELAY_ctx_T* ctx,
+                        uint32_t relay_id,
+                        error_listener_T listener,
+                        RELAY_listener_id_T* listener_id)
 {
-    DO_state_E close_state = m_config[relay_id].type == RELAY_type_NO ? DO_state_ON : DO_state_OFF;
+    bool ret = false;
+
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited && relay_id < ctx->relays_number)
+    {
+        RELAY_LOCK(ctx->relays.locks[relay_id]);
+
+        uint32_t* n = &ctx->relays.listeners[relay_id].error.number;
 
-    DO_setOutputState(m_config[relay_id].control_index, close_state);
+        if (*n < MAX_ERROR_LISTENERS_PER_RELAY)
+        {
+            ctx->relays.listeners[relay_id].error.items[*n] = listener;
+            *listener_id = *n;
+            ++*n;
+            ret = true;
+        }
+
+        RELAY_UNLOCK(ctx->relays.locks[relay_id]);
+    }
+    UNLOCK(ctx->lock);
+
+    LOG("%s(relay_id: %d, listener_id: %d): %d", __PRETTY_FUNCTION__, relay_id, *listener_id, ret);
+
+    return ret;
 }
 
-static void open(uint32_t relay_id)
+// Command of one relay, with completion when func is given
+RELAY_command_E command_one(RELAY_ctx_T* ctx,
+                            uint32_t relay_id,
+                            event_E event,
+                            RELAY_completion_func_T func,
+                            void* arg)
 {
-    DO_state_E open_state = m_config[relay_id].type == RELAY_type_NO ? DO_state_OFF : DO_state_ON;
+    RELAY_command_E ret = RELAY_command_REJECTED;
+
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited && relay_id < ctx->relays_number)
+    {
+        uint16_t index = func != NULL ? alloc_completion(ctx) : (uint16_t)NO_COMPLETION;
+
+        if (func == NULL || index != NO_COMPLETION)
+        {
+            RELAY_LOCK(ctx->relays.locks[relay_id]);
+            ret = apply_command(ctx, relay_id, event);
+
+            if (index != NO_COMPLETION && ret == RELAY_command_REJECTED)
+                free_completion(ctx, index);
+            else if (index != NO_COMPLETION)
+            {
+                completion_T* completion = &ctx->completions[index];
+                uint16_t* link = &ctx->relays.completions[relay_id];
+
+                completion->func = func;
+                completion->arg = arg;
+                completion->relay_id = relay_id;
+                completion->event = (uint8_t)event;
+                completion->result = NO_RESULT;
+                completion->next = NO_COMPLETION;
+
+                // relay list keeps command order, it is short
+                while (*link != NO_COMPLETION)
+                {
+                    link = &ctx->completions[*link].next;
+                }
+                *link = index;
+
+                // relay is in commanded state already
+                if (ret == RELAY_command_MERGED && ctx->relays.sm_state[relay_id] ==
+                                                       (event == event_OPEN ? sm_state_OPEN
+                                                                            : sm_state_CLOSE))
+                {
+                    resolve_completions(ctx, relay_id, (uint8_t)event, RELAY_result_OK);
+                    post_completions(ctx, relay_id);
+                    update_bits(ctx, relay_id);
+                }
+            }
+            RELAY_UNLOCK(ctx->relays.locks[relay_id]);
+        }
+    }
+    UNLOCK(ctx->lock);
+
+    if (ret == RELAY_command_REJECTED)
+    {
+        LOG_ERROR("Relay[%d] command %d rejected", relay_id, event);
+    }
+
+    // start switching check at once, completion is delivered by routine pass
+    if (ret == RELAY_command_APPLIED || (func != NULL && ret != RELAY_command_REJECTED))
+    {
+        wakeup(ctx, 0);
+    }
 
-    DO_setOutputState(m_config[relay_id].control_index, open_state);
+    return ret;
 }
 
-bool is_closed(uint32_t relay_id)
+uint32_t command_many(RELAY_ctx_T* ctx, const uint32_t* relay_ids, uint32_t number, event_E event)
 {
-    return DI_getInputState(m_config[relay_id].feedback_index) == DI_state_ON ? true : false;
+    uint32_t ret = 0;
+    batch_T batch;
+
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited)
+    {
+        begin_batch(ctx, &batch);
+
+        for (uint32_t i = 0; i < number; ++i)
+        {
+            uint32_t relay_id = relay_ids[i];
+
+            if (relay_id >= ctx->relays_number) continue;
+
+            RELAY_LOCK(ctx->relays.locks[relay_id]);
+            if (apply_command(ctx, relay_id, event) != RELAY_command_REJECTED) ++ret;
+            RELAY_UNLOCK(ctx->relays.locks[relay_id]);
+        }
+
+        end_batch(ctx, &batch);
+    }
+    UNLOCK(ctx->lock);
+
+    if (ret) wakeup(ctx, 0); // start switching check without waiting period
+
+    return ret;
 }
 
-void notify_error_listeners(uint32_t relay_id, RELAY_error_E error)
+bool command_async(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
 {
-    uint32_t* n = &m_relays[relay_id].error_listeners.number;
+    bool ret = false;
+    command_T command = {relay_id, event};
+
+    // shared lock is blocked only by init/deinit in progress
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited && relay_id < ctx->relays_number)
+    {
+        ret = MPSC_push(&ctx->queue, &command);
 
-    for (uint32_t i = 0; i < *n; ++i)
+        if (ret)
+            ATOMIC_ADD(ctx->queue_accepted, 1u);
+        else
+            ATOMIC_ADD(ctx->queue_dropped, 1u);
+    }
+    UNLOCK(ctx->lock);
+
+    if (!ret)
     {
-        m_relays[relay_id].error_listeners.funcs[i](relay_id, error);
+        LOG_ERROR("Relay[%d] async command %d rejected", relay_id, event);
     }
+
+    if (ret) wakeup(ctx, 0);
+
+    return ret;
 }
 
-void notify_state_listeners(uint32_t relay_id, RELAY_state_E state)
+// Apply async commands as one batch, called by RELAY_routine which is the only queue consumer
+void drain_commands(RELAY_ctx_T* ctx)
 {
-    uint32_t* n = &m_relays[relay_id].state_listeners.number;
+    command_T command;
+    batch_T batch;
+
+    if (MPSC_get_depth(&ctx->queue) == 0) return;
+
+    begin_batch(ctx, &batch);
 
-    for (uint32_t i = 0; i < *n; ++i)
+    while (MPSC_pop(&ctx->queue, &command))
     {
-        m_relays[relay_id].state_listeners.funcs[i](relay_id, state);
+        RELAY_LOCK(ctx->relays.locks[command.relay_id]);
+        apply_command(ctx, command.relay_id, (event_E)command.event);
+        RELAY_UNLOCK(ctx->relays.locks[command.relay_id]);
     }
+
+    end_batch(ctx, &batch);
 }
 
-static void log_config(void)
+bool command_at(RELAY_ctx_T* ctx,
+                uint32_t relay_id,
+                event_E event,
+                CLOCK_ticks_T at,
+                RELAY_timer_id_T* timer_id)
 {
-    LOG("%s()", __PRETTY_FUNCTION__);
+    bool ret = false;
+
+    LOCK_SHARED(ctx->lock);
+    if (ctx->inited && relay_id < ctx->relays_number)
+    {
+        RELAY_LOCK(ctx->timers_lock);
+        uint16_t index = ctx->timers_free;
+
+        if (index != NO_TIMER)
+        {
+            timer_T* timer = &ctx->timers[index];
+
+            ctx->timers_free = timer->next;
+            timer->relay_id = relay_id;
+            timer->event = (uint8_t)event;
+            ++timer->generation;
+            WHEEL_add(&ctx->wheel, &timer->node, at);
 
-    if (m_config == NULL) return;
+            if (timer_id != NULL) *timer_id = TIMER_ID_MAKE(index, timer->generation);
+            ret = true;
+        }
+        RELAY_UNLOCK(ctx->timers_lock);
+    }
+    UNLOCK(ctx->lock);
 
-    for (uint32_t i = 0; i < m_relays_number; ++i)
+    // routine may sleep past timer otherwise, later wakeups are renewed by each pass
+    if (ret)
     {
-        RELAY_config_T* c = &m_config[i];
+        uint32_t delay = ticks_to_delay(at, get_ticks(ctx));
 
-        LOG("Relay[%d] config:", i);
-        LOG("  type: %s", c->type == RELAY_type_NO ? "NO" : "NC");
-        LOG("  control_index: %d", c->control_index);
-        LOG("  feedback_index: %d", c->feedback_index);
-        LOG("  response_ms: %d", c->response_ms);
+        if (delay != NO_DEADLINE) wakeup(ctx, delay);
+    }
+
+    return ret;
+}
+
+// Apply scheduled commands due till now, called by RELAY_routine. Commands due at one tick are
+// applied as one batch, so their relays start switching together and DO lines are set at once.
+void fire_timers(RELAY_ctx_T* ctx)
+{
+    CLOCK_ticks_T now = get_ticks(ctx);
+    CLOCK_ticks_T next;
+    batch_T batch;
+
+    RELAY_LOCK(ctx->timers_lock);
+    if (WHEEL_get_next(&ctx->wheel, &next) && CLOCK_IS_DUE(next, now))
+    {
+        begin_batch(ctx, &batch);
+        WHEEL_advance(&ctx->wheel, now, fire_timer, ctx);
+        end_batch(ctx, &batch);
+    }
+    RELAY_UNLOCK(ctx->timers_lock);
+}
+
+// Expired timer, called under timers lock
+void fire_timer(WHEEL_timer_T* node, void* arg)
+{
+    RELAY_ctx_T* ctx = (RELAY_ctx_T*)arg;
+    timer_T* timer = (timer_T*)node;
+
+    RELAY_LOCK(ctx->relays.locks[timer->relay_id]);
+    apply_command(ctx, timer->relay_id, (event_E)timer->event);
+    RELAY_UNLOCK(ctx->relays.locks[timer->relay_id]);
+
+    timer->next = ctx->timers_free;
+    ctx->timers_free = (uint16_t)(timer - ctx->timers);
+}
+
+// Delay till wheel should be advanced, may be before nearest timer when wheel moves timers down
+uint32_t next_timer_delay(RELAY_ctx_T* ctx)
+{
+    uint32_t delay = NO_DEADLINE;
+    CLOCK_ticks_T next;
+
+    RELAY_LOCK(ctx->timers_lock);
+    if (WHEEL_get_next(&ctx->wheel, &next)) delay = ticks_to_delay(next, get_ticks(ctx));
+    RELAY_UNLOCK(ctx->timers_lock);
+
+    return delay;
+}
+
+// Delay in ms till tick, NO_DEADLINE if it doesn't fit
+uint32_t ticks_to_delay(CLOCK_ticks_T at, CLOCK_ticks_T now)
+{
+    if (CLOCK_IS_DUE(at, now)) return 0;
+
+    CLOCK_ticks_T delay = CLOCK_TICKS_TO_MS(at - now);
+
+    return delay < NO_DEADLINE ? (uint32_t)delay : NO_DEADLINE;
+}
+
+void begin_batch(RELAY_ctx_T* ctx, batch_T* batch)
+{
+    for (uint32_t port = 0; port < DO_PORTS_NUMBER; ++port)
+    {
+        batch->mask[port] = 0;
+        batch->states[port] = 0;
+    }
+
+    batch->ctx = ctx;
+    batch->now = get_ticks(ctx);
+    m_batch = batch;
+}
+
+void end_batch(RELAY_ctx_T* ctx, batch_T* batch)
+{
+    m_batch = NULL;
+
+    for (uint32_t port = 0; port < DO_PORTS_NUMBER; ++port)
+    {
+        if (batch->mask[port] != 0)
+        {
+            ctx->hal.set_outputs(ctx->hal.arg, port, batch->mask[port], batch->states[port]);
+        }
+    }
+}
+
+bool init(
+    RELAY_ctx_T* ctx, RELAY_config_T* config, uint32_t relays_number, const relays_T* relays)
+{
+    bool ret = false;
+
+    if (!is_config_valid(config, relays_number)) return false;
+
+    LOCK(ctx->lock);
+    if (!ctx->inited)
+    {
+        MPSC_init(&ctx->queue, ctx->queue_storage, RELAY_QUEUE_SIZE, sizeof(command_T));
+        MPSC_init(
+            &ctx->events, ctx->events_storage, RELAY_EVENT_QUEUE_SIZE, sizeof(notification_T));
+
+        // no waiter is blocked before first init, cond stays initialized till instance is released
+        if (!ctx->wait_ready)
+        {
+            RELAY_COND_INIT(ctx->wait_cond);
+            ctx->wait_ready = true;
+        }
+
+        for (uint32_t i = 0; i < RELAY_COMPLETIONS_NUMBER; ++i)
+        {
+            ctx->completions[i].func = NULL;
+            ctx->completions[i].next = i + 1u < RELAY_COMPLETIONS_NUMBER ? (uint16_t)(i + 1u)
+                                                                         : (uint16_t)NO_COMPLETION;
+        }
+        ctx->completions_free = 0;
+
+        // timers pending at deinit were dropped, generations are kept so their ids stay stale
+        WHEEL_init(&ctx->wheel, get_ticks(ctx));
+        for (uint32_t i = 0; i < RELAY_TIMERS_NUMBER; ++i)
+        {
+            WHEEL_init_timer(&ctx->timers[i].node);
+            ctx->timers[i].next =
+                i + 1u < RELAY_TIMERS_NUMBER ? (uint16_t)(i + 1u) : (uint16_t)NO_TIMER;
+        }
+        ctx->timers_free = 0;
+
+        ctx->config = config;
+        ctx->relays = *relays;
+        ctx->self_check_time = get_ticks(ctx);
+        ATOMIC_STORE(ctx->relays.snapshot, relays->snapshot);
+
+        log_config(ctx, relays_number);
+
+        for (uint32_t i = 0; i < relays_number; ++i)
+        {
+            init_relay(ctx, i);
+            init_state_machine(ctx, i);
+        }
+
+        // relays are ready, publish them for lock-free readers
+        ATOMIC_STORE(ctx->relays_number, relays_number);
+
+        ctx->inited = true;
+        ret = true;
+    }
+    UNLOCK(ctx->lock);
+
+    return ret;
+}
+
+// Pins index DO and DI port words of each pass, so config out of board is rejected
+bool is_config_valid(const RELAY_config_T* config, uint32_t relays_number)
+{
+    if (config == NULL && relays_number != 0) return false;
+
+    for (uint32_t i = 0; i < relays_number; ++i)
+    {
+        if ((uint32_t)config[i].control_index >= (uint32_t)DO_index_NUMBER ||
+            (uint32_t)config[i].feedback_index > (uint32_t)RELAY_WO_FEEDBACK)
+        {
+            LOG_ERROR("Relay[%d] pins out of board", i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Arrays are placed by descending alignment, so each one stays aligned. NULL storage - size only
+size_t carve_storage(relays_T* relays, uint8_t* storage, uint32_t relays_number)
+{
+    size_t offset = 0;
+    uint32_t words = BITS_WORDS(relays_number);
+
+    relays->words = words;
+    relays->has_feedback = (bits_T*)(storage + offset);
+    offset += sizeof(bits_T) * words;
+    relays->stable = (bits_T*)(storage + offset);
+    offset += sizeof(bits_T) * words;
+    relays->expected_closed = (bits_T*)(storage + offset);
+    offset += sizeof(bits_T) * words;
+    relays->active = (bits_T*)(storage + offset);
+    offset += sizeof(bits_T) * words;
+    relays->locks = (RELAY_LOCK_T*)(storage + offset);
+    offset += sizeof(RELAY_LOCK_T) * relays_number;
+    relays->listeners = (listeners_T*)(storage + offset);
+    offset += sizeof(listeners_T) * relays_number;
+    relays->patterns = (pattern_T*)(storage + offset);
+    offset += sizeof(pattern_T) * relays_number;
+    relays->deadline = (CLOCK_ticks_T*)(storage + offset);
+    offset += sizeof(CLOCK_ticks_T) * relays_number;
+    relays->settle_time = (CLOCK_ticks_T*)(storage + offset);
+    offset += sizeof(CLOCK_ticks_T) * relays_number;
+    relays->snapshot = (uint32_t*)(storage + offset);
+    offset += sizeof(uint32_t) * relays_number;
+    relays->feedback = (uint16_t*)(storage + offset);
+    offset += sizeof(uint16_t) * relays_number;
+    relays->completions = (uint16_t*)(storage + offset);
+    offset += sizeof(uint16_t) * relays_number;
+    relays->sm_state = storage + offset;
+    offset += sizeof(uint8_t) * relays_number;
+    relays->flags = storage + offset;
+    offset += sizeof(uint8_t) * relays_number;
+    relays->latched = storage + offset;
+    offset += sizeof(uint8_t) * relays_number;
+
+    return offset;
+}
+
+void init_relay(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    RELAY_LOCK_INIT(ctx->relays.locks[relay_id]);
+
+    // bitsets are cleared by word, relay ids come in order
+    if (relay_id % BITS_WIDTH == 0)
+    {
+        uint32_t word = relay_id / BITS_WIDTH;
+
+        ctx->relays.has_feedback[word] = 0;
+        ctx->relays.stable[word] = 0;
+        ctx->relays.expected_closed[word] = 0;
+        ctx->relays.active[word] = 0;
+    }
+
+    if (ctx->config[relay_id].feedback_index < DI_index_NUMBER)
+    {
+        set_bit(ctx->relays.has_feedback, relay_id, true);
+    }
+
+    ctx->relays.flags[relay_id] = 0;
+    ctx->relays.latched[relay_id] = NO_COMMAND;
+    ctx->relays.completions[relay_id] = NO_COMPLETION;
+    ctx->relays.feedback[relay_id] = (uint16_t)ctx->config[relay_id].feedback_index;
+    ctx->relays.deadline[relay_id] = 0;
+    ctx->relays.settle_time[relay_id] = 0;
+    ctx->relays.listeners[relay_id].state.number = 0;
+    ctx->relays.listeners[relay_id].error.number = 0;
+}
+
+void init_state_machine(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    LOG("%s(relay_id: %d)", __PRETTY_FUNCTION__, relay_id);
+
+    if (ctx->config[relay_id].type == RELAY_type_NO)
+    {
+        ctx->relays.sm_state[relay_id] = sm_state_OPEN;
     }
+    else
+        ctx->relays.sm_state[relay_id] = sm_state_CLOSE;
+
+    update_bits(ctx, relay_id);
+    publish_snapshot(ctx, relay_id);
+}
+
+void step_state_machine(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    sm_state_E cur_state = (sm_state_E)ctx->relays.sm_state[relay_id];
+
+    // new verdict waits till notification of previous one is posted, so no state is skipped. Relay
+    // stays active meanwhile, as its flags are set.
+    if (!post_fired(ctx, relay_id) && event == event_SELF_CHECK) return;
+
+    sm_state_ret_E ret = m_state_funcs[cur_state](ctx, relay_id, event);
+
+    sm_state_E new_state = do_transition(cur_state, ret);
+
+    ctx->relays.sm_state[relay_id] = (uint8_t)new_state;
+
+    uint8_t latched = ctx->relays.latched[relay_id];
+
+    if (new_state != cur_state)
+    {
+        publish_snapshot(ctx, relay_id);
+
+        // command latched during switching is applied as soon as it completes, dropped on error
+        if (latched != NO_COMMAND && new_state != sm_state_OPEN && new_state != sm_state_CLOSE)
+        {
+            resolve_completions(ctx, relay_id, latched, RELAY_result_CANCELLED);
+            latched = NO_COMMAND;
+        }
+        ctx->relays.latched[relay_id] = NO_COMMAND;
+
+        // switching pattern stops when relay fails
+        if (new_state == sm_state_ERROR_CONST_OPEN || new_state == sm_state_ERROR_WELDED ||
+            new_state == sm_state_DEINIT)
+        {
+            ctx->relays.flags[relay_id] &= (uint8_t)~FLAG_PATTERN;
+        }
+
+        switch (new_state)
+        {
+        case sm_state_OPEN:
+            resolve_completions(ctx, relay_id, event_OPEN, RELAY_result_OK);
+            break;
+        case sm_state_CLOSE:
+            resolve_completions(ctx, relay_id, event_CLOSE, RELAY_result_OK);
+            break;
+        case sm_state_ERROR_CONST_OPEN:
+            LOG_ERROR("Relay[%d] constantly open", relay_id);
+            resolve_completions(ctx, relay_id, NO_COMMAND, RELAY_result_CONSTANTLY_OPEN);
+            break;
+        case sm_state_ERROR_WELDED:
+            LOG_ERROR("Relay[%d] welded", relay_id);
+            resolve_completions(ctx, relay_id, NO_COMMAND, RELAY_result_WELDED);
+            break;
+        default:
+            resolve_completions(ctx, relay_id, NO_COMMAND, RELAY_result_CANCELLED);
+            break;
+        case sm_state_OPEN_TO_CLOSE:
+        case sm_state_CLOSE_TO_OPEN:
+            break;
+        }
+    }
+
+    (void)post_fired(ctx, relay_id);
+    post_completions(ctx, relay_id);
+    update_bits(ctx, relay_id);
+
+    if (new_state != cur_state && latched != NO_COMMAND)
+    {
+        step_state_machine(ctx, relay_id, (event_E)latched);
+    }
+}
+
+// Switching command, called under relay lock. Command of stable relay is applied, command of
+// switching relay is latched, command already in progress or latched is merged with it. Command
+// stops switching pattern of relay.
+RELAY_command_E apply_command(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    sm_state_E cur_state = (sm_state_E)ctx->relays.sm_state[relay_id];
+    uint8_t latched = ctx->relays.latched[relay_id];
+
+    // command takes relay over from its switching pattern
+    ctx->relays.flags[relay_id] &= (uint8_t)~FLAG_PATTERN;
+
+    step_state_machine(ctx, relay_id, event);
+
+    // latched command is cancelled by one of switching in progress
+    if (latched != NO_COMMAND && ctx->relays.latched[relay_id] == NO_COMMAND &&
+        ctx->relays.sm_state[relay_id] == cur_state)
+    {
+        resolve_completions(ctx, relay_id, latched, RELAY_result_CANCELLED);
+        post_completions(ctx, relay_id);
+        update_bits(ctx, relay_id);
+    }
+
+    switch (cur_state)
+    {
+    case sm_state_OPEN:
+    case sm_state_CLOSE:
+        return ctx->relays.sm_state[relay_id] != cur_state ? RELAY_command_APPLIED
+                                                             : RELAY_command_MERGED;
+
+    case sm_state_OPEN_TO_CLOSE:
+    case sm_state_CLOSE_TO_OPEN:
+        return latched != event && ctx->relays.latched[relay_id] == event ? RELAY_command_LATCHED
+                                                                          : RELAY_command_MERGED;
+
+    default:
+        return RELAY_command_REJECTED;
+    }
+}
+
+void update_bits(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    sm_state_E sm_state = (sm_state_E)ctx->relays.sm_state[relay_id];
+    bool switching = sm_state == sm_state_OPEN_TO_CLOSE || sm_state == sm_state_CLOSE_TO_OPEN;
+
+    set_bit(ctx->relays.stable, relay_id, sm_state == sm_state_OPEN || sm_state == sm_state_CLOSE);
+    set_bit(ctx->relays.expected_closed, relay_id, sm_state == sm_state_CLOSE);
+    set_bit(ctx->relays.active, relay_id, switching || ctx->relays.flags[relay_id] != 0);
+}
+
+// Relays of one word are updated under different relay locks, so word is changed atomically
+void set_bit(bits_T* bits, uint32_t relay_id, bool value)
+{
+    bits_T* word = &bits[relay_id / BITS_WIDTH];
+    bits_T bit = (bits_T)1u << (relay_id % BITS_WIDTH);
+
+    if (((ATOMIC_LOAD(*word) & bit) != 0) == value) return;
+
+    if (value)
+        ATOMIC_OR(*word, bit);
+    else
+        ATOMIC_AND(*word, ~bit);
+}
+
+// Self check of relays range, each relay is stepped by one thread so its notifications keep order.
+// Only active relays and relays with feedback mismatch are stepped, healthy stable ones are
+// checked by bitset operations on whole words.
+void sweep_relays(RELAY_ctx_T* ctx, uint32_t begin, uint32_t end)
+{
+    uint32_t delay = NO_DEADLINE;
+    uint32_t end_word = BITS_WORDS(end);
+
+    for (uint32_t word = begin / BITS_WIDTH; word < end_word; word += SWEEP_BLOCK_WORDS)
+    {
+        bits_T todo[SWEEP_BLOCK_WORDS];
+        uint32_t words = end_word - word < SWEEP_BLOCK_WORDS ? end_word - word : SWEEP_BLOCK_WORDS;
+
+        if (sweep_block(ctx, word, words, todo) == 0) continue;
+
+        for (uint32_t w = 0; w < words; ++w)
+        {
+            for (bits_T bits = todo[w]; bits != 0; bits &= bits - 1u)
+            {
+                uint32_t i = (word + w) * BITS_WIDTH + BIT_SCAN(bits);
+
+                if (i < begin || i >= end) continue;
+
+                RELAY_LOCK(ctx->relays.locks[i]);
+                step_state_machine(ctx, i, event_SELF_CHECK);
+
+                uint32_t relay_delay = next_step_delay(ctx, i, ctx->sweep.now);
+                if (relay_delay < delay) delay = relay_delay;
+                RELAY_UNLOCK(ctx->relays.locks[i]);
+            }
+        }
+    }
+
+    uint32_t cur = ATOMIC_LOAD(ctx->sweep.delay);
+
+    while (delay < cur && !ATOMIC_CAS(ctx->sweep.delay, cur, delay))
+    {
+    }
+}
+
+// Relays to be stepped in block of words, returns union of all block words to skip empty blocks.
+// Words are read without atomics for vectorization: bit changed concurrently by command is seen
+// on next pass, the command itself wakes routine up.
+bits_T sweep_block(RELAY_ctx_T* ctx, uint32_t word, uint32_t words, bits_T* todo)
+{
+    bits_T any = 0;
+
+    for (uint32_t w = 0; w < words; ++w)
+    {
+        todo[w] = 0;
+    }
+
+    // without full check only relays on changed pins are checked, none when nothing changed
+    if (ctx->sweep.full_check || ctx->sweep.changed)
+    {
+        bits_T closed[SWEEP_BLOCK_WORDS];
+
+        gather_pins(ctx, ctx->sweep.inputs, word, words, closed);
+
+        for (uint32_t w = 0; w < words; ++w)
+        {
+            todo[w] = (closed[w] ^ ctx->relays.expected_closed[word + w]) &
+                      ctx->relays.has_feedback[word + w] & ctx->relays.stable[word + w];
+        }
+    }
+
+    if (!ctx->sweep.full_check && ctx->sweep.changed)
+    {
+        bits_T changed[SWEEP_BLOCK_WORDS];
+
+        gather_pins(ctx, ctx->sweep.changes, word, words, changed);
+
+        for (uint32_t w = 0; w < words; ++w)
+        {
+            todo[w] &= changed[w];
+        }
+    }
+
+    for (uint32_t w = 0; w < words; ++w)
+    {
+        todo[w] |= ctx->relays.active[word + w];
+        any |= todo[w];
+    }
+
+    return any;
+}
+
+// Bitset words of relays block with bit of each relay taken from its feedback pin in port words,
+// one lookup per relay, so cost doesn't depend on number of pins
+void gather_pins(
+    RELAY_ctx_T* ctx, const DI_mask_T* ports, uint32_t word, uint32_t words, bits_T* bits)
+{
+    const uint16_t* feedback = ctx->relays.feedback;
+
+    for (uint32_t w = 0; w < words; ++w)
+    {
+        uint32_t begin = (word + w) * BITS_WIDTH;
+        uint32_t end = begin + BITS_WIDTH;
+        bits_T gathered = 0;
+
+        if (end > ctx->relays_number) end = ctx->relays_number;
+
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            uint32_t pin = feedback[i];
+
+            gathered |= (bits_T)((ports[pin / DI_PORT_WIDTH] >> (pin % DI_PORT_WIDTH)) & 1u)
+                        << (i - begin);
+        }
+
+        bits[w] = gathered;
+    }
+}
+
+// Sample feedback lines for the pass, one bus transaction per port instead of one per relay. When
+// board reports DI changes, only relays on changed pins are checked besides low frequency full
+// check, otherwise all of them are checked on each pass.
+void sample_inputs(RELAY_ctx_T* ctx)
+{
+    sweep_T* sweep = &ctx->sweep;
+
+    // changes are taken before sample, so change after sample is seen by next pass
+    sweep->changed = false;
+    if (ctx->hal.get_changes != NULL)
+    {
+        for (uint32_t port = 0; port < DI_PORTS_NUMBER; ++port)
+        {
+            sweep->changes[port] = ctx->hal.get_changes(ctx->hal.arg, port);
+            sweep->changed = sweep->changed || sweep->changes[port] != 0;
+        }
+    }
+    sweep->changes[DI_PORTS_NUMBER] = 0;
+
+    sweep->now = get_ticks(ctx);
+    sweep->full_check =
+        ctx->hal.get_changes == NULL || CLOCK_IS_DUE(ctx->self_check_time, sweep->now);
+
+    if (sweep->full_check)
+    {
+        ctx->self_check_time = sweep->now + CLOCK_MS_TO_TICKS(RELAY_SELF_CHECK_PERIOD_MS);
+    }
+
+    for (uint32_t port = 0; port < DI_PORTS_NUMBER; ++port)
+    {
+        sweep->inputs[port] = ctx->hal.get_inputs(ctx->hal.arg, port);
+    }
+    sweep->inputs[DI_PORTS_NUMBER] = 0;
+
+    sweep->delay = NO_DEADLINE;
+}
+
+void sweep_shard(uint32_t shard, void* arg)
+{
+    RELAY_ctx_T* ctx = (RELAY_ctx_T*)arg;
+    uint32_t begin = shard * RELAY_SHARD_SIZE;
+    uint32_t end = begin + RELAY_SHARD_SIZE;
+
+    if (end > ctx->relays_number) end = ctx->relays_number;
+
+    sweep_relays(ctx, begin, end);
+}
+
+uint32_t next_step_delay(RELAY_ctx_T* ctx, uint32_t relay_id, CLOCK_ticks_T now)
+{
+    sm_state_E sm_state = (sm_state_E)ctx->relays.sm_state[relay_id];
+
+    // notification left pending by full queue is posted on next step, dispatch making room wakes
+    // routine up, so relay doesn't need step before that
+    if (ctx->relays.flags[relay_id] & (FLAG_FIRE_STATE | FLAG_FIRE_ERROR | FLAG_FIRE_COMPLETION))
+    {
+        return MPSC_get_depth(&ctx->events) < RELAY_EVENT_QUEUE_SIZE ? 0 : NO_DEADLINE;
+    }
+
+    if (sm_state == sm_state_OPEN_TO_CLOSE || sm_state == sm_state_CLOSE_TO_OPEN)
+    {
+        CLOCK_ticks_T deadline = ctx->relays.deadline[relay_id];
+
+        // confirming feedback completes transition when it is stable, before response time
+        if ((ctx->relays.flags[relay_id] & FLAG_SETTLING) &&
+            CLOCK_IS_DUE(ctx->relays.settle_time[relay_id], deadline))
+        {
+            deadline = ctx->relays.settle_time[relay_id];
+        }
+
+        if (CLOCK_IS_DUE(deadline, now)) return 0;
+
+        CLOCK_ticks_T delay = CLOCK_TICKS_TO_MS(deadline - now);
+
+        return delay < NO_DEADLINE ? (uint32_t)delay : NO_DEADLINE - 1u;
+    }
+
+    // stable relay with switching pattern is stepped at its next edge
+    if ((sm_state == sm_state_OPEN || sm_state == sm_state_CLOSE) &&
+        (ctx->relays.flags[relay_id] & FLAG_PATTERN))
+    {
+        CLOCK_ticks_T edge = ctx->relays.patterns[relay_id].next_edge;
+
+        if (CLOCK_IS_DUE(edge, now)) return 0;
+
+        CLOCK_ticks_T delay = CLOCK_TICKS_TO_MS(edge - now);
+
+        return delay < NO_DEADLINE ? (uint32_t)delay : NO_DEADLINE - 1u;
+    }
+
+    return NO_DEADLINE;
+}
+
+sm_state_ret_E not_init_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    (void)ctx;
+    (void)relay_id; // used by LOG_DEBUG only
+    (void)event;
+
+    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+
+    LOG_DEBUG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+
+    return ret;
+}
+
+sm_state_ret_E open_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+
+    switch (event)
+    {
+    case event_OPEN:
+    default:
+        ret = sm_state_ret_NO_TRANSITION;
+        break;
+
+    case event_CLOSE:
+        close(ctx, relay_id);
+        ctx->relays.deadline[relay_id] =
+            command_time(ctx) + CLOCK_MS_TO_TICKS(ctx->config[relay_id].response_ms);
+        ret = sm_state_ret_OK;
+        break;
+
+    case event_SELF_CHECK:
+        if (ctx->relays.feedback[relay_id] != RELAY_WO_FEEDBACK && is_closed(ctx, relay_id))
+        {
+            ctx->relays.flags[relay_id] |= FLAG_FIRE_ERROR;
+            ret = sm_state_ret_NOK;
+        }
+        else if (take_pattern_edge(ctx, relay_id, true))
+        {
+            close(ctx, relay_id);
+            ctx->relays.deadline[relay_id] =
+                command_time(ctx) + CLOCK_MS_TO_TICKS(ctx->config[relay_id].response_ms);
+            ret = sm_state_ret_OK;
+        }
+        break;
+
+    case event_DEINIT:
+        ret = sm_state_ret_DEINIT;
+        break;
+    }
+
+    LOG_DEBUG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+
+    return ret;
+}
+
+sm_state_ret_E open_to_close_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+
+    if (event == event_DEINIT)
+        ret = sm_state_ret_DEINIT;
+    else if (event == event_OPEN || event == event_CLOSE)
+    {
+        // last command wins: opposite one is latched, one of switching in progress cancels it
+        ctx->relays.latched[relay_id] = event == event_OPEN ? (uint8_t)event : (uint8_t)NO_COMMAND;
+    }
+    else if (event == event_SELF_CHECK) // verdict is given by RELAY_routine only, on its sample
+    {
+        bool due = CLOCK_IS_DUE(ctx->relays.deadline[relay_id], ctx->sweep.now);
+
+        if (ctx->relays.feedback[relay_id] == RELAY_WO_FEEDBACK)
+        {
+            if (due)
+            {
+                ctx->relays.flags[relay_id] |= FLAG_FIRE_STATE;
+                ret = sm_state_ret_OK;
+            }
+        }
+        else
+        {
+            // stable confirming feedback completes transition, response time is its timeout
+            bool closed = is_closed(ctx, relay_id);
+
+            if (is_settled(ctx, relay_id, closed) || (due && closed))
+            {
+                ctx->relays.flags[relay_id] |= FLAG_FIRE_STATE;
+                ret = sm_state_ret_OK;
+            }
+            else if (due)
+            {
+                ctx->relays.flags[relay_id] |= FLAG_FIRE_ERROR;
+                ret = sm_state_ret_NOK;
+            }
+
+            if (ret != sm_state_ret_NO_TRANSITION)
+            {
+                ctx->relays.flags[relay_id] &= (uint8_t)~FLAG_SETTLING;
+            }
+        }
+    }
+
+    LOG_DEBUG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+
+    return ret;
+}
+
+sm_state_ret_E close_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+
+    switch (event)
+    {
+    case event_OPEN:
+        open(ctx, relay_id);
+        ctx->relays.deadline[relay_id] =
+            command_time(ctx) + CLOCK_MS_TO_TICKS(ctx->config[relay_id].response_ms);
+        ret = sm_state_ret_OK;
+        break;
+
+    case event_CLOSE:
+    default:
+        ret = sm_state_ret_NO_TRANSITION;
+        break;
+
+    case event_SELF_CHECK:
+        if (ctx->relays.feedback[relay_id] != RELAY_WO_FEEDBACK && !is_closed(ctx, relay_id))
+        {
+            ctx->relays.flags[relay_id] |= FLAG_FIRE_ERROR;
+            ret = sm_state_ret_NOK;
+        }
+        else if (take_pattern_edge(ctx, relay_id, false))
+        {
+            open(ctx, relay_id);
+            ctx->relays.deadline[relay_id] =
+                command_time(ctx) + CLOCK_MS_TO_TICKS(ctx->config[relay_id].response_ms);
+            ret = sm_state_ret_OK;
+        }
+        break;
+
+    case event_DEINIT:
+        ret = sm_state_ret_DEINIT;
+        break;
+    }
+
+    LOG_DEBUG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+
+    return ret;
+}
+
+sm_state_ret_E close_to_open_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+
+    if (event == event_DEINIT)
+        ret = sm_state_ret_DEINIT;
+    else if (event == event_OPEN || event == event_CLOSE)
+    {
+        // last command wins: opposite one is latched, one of switching in progress cancels it
+        ctx->relays.latched[relay_id] = event == event_CLOSE ? (uint8_t)event : (uint8_t)NO_COMMAND;
+    }
+    else if (event == event_SELF_CHECK) // verdict is given by RELAY_routine only, on its sample
+    {
+        bool due = CLOCK_IS_DUE(ctx->relays.deadline[relay_id], ctx->sweep.now);
+
+        if (ctx->relays.feedback[relay_id] == RELAY_WO_FEEDBACK)
+        {
+            if (due)
+            {
+                ctx->relays.flags[relay_id] |= FLAG_FIRE_STATE;
+                ret = sm_state_ret_OK;
+            }
+        }
+        else
+        {
+            // stable confirming feedback completes transition, response time is its timeout
+            bool opened = !is_closed(ctx, relay_id);
+
+            if (is_settled(ctx, relay_id, opened) || (due && opened))
+            {
+                ctx->relays.flags[relay_id] |= FLAG_FIRE_STATE;
+                ret = sm_state_ret_OK;
+            }
+            else if (due)
+            {
+                ctx->relays.flags[relay_id] |= FLAG_FIRE_ERROR;
+                ret = sm_state_ret_NOK;
+            }
+
+            if (ret != sm_state_ret_NO_TRANSITION)
+            {
+                ctx->relays.flags[relay_id] &= (uint8_t)~FLAG_SETTLING;
+            }
+        }
+    }
+
+    LOG_DEBUG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+
+    return ret;
+}
+
+sm_state_ret_E error_const_open_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    (void)ctx;
+    (void)relay_id; // used by LOG_DEBUG only
+
+    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+
+    if (event == event_DEINIT) ret = sm_state_ret_DEINIT;
+
+    LOG_DEBUG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+
+    return ret;
+}
+
+sm_state_ret_E error_welded_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    (void)ctx;
+    (void)relay_id; // used by LOG_DEBUG only
+
+    sm_state_ret_E ret = sm_state_ret_NO_TRANSITION;
+
+    if (event == event_DEINIT) ret = sm_state_ret_DEINIT;
+
+    LOG_DEBUG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+
+    return ret;
+}
+
+static sm_state_ret_E deinit_state(RELAY_ctx_T* ctx, uint32_t relay_id, event_E event)
+{
+    (void)event; // used by LOG_DEBUG only
+
+    sm_state_ret_E ret = sm_state_ret_OK;
+
+    if(ctx->config[relay_id].type == RELAY_type_NO)
+        open(ctx, relay_id);
+    else close(ctx, relay_id);
+
+    LOG_DEBUG("%s(relay_id: %d, event: %d): %d", __PRETTY_FUNCTION__, relay_id, event, ret);
+
+    return ret;
+}
+
+sm_state_E do_transition(sm_state_E cur_state, sm_state_ret_E state_ret)
+{
+    for (size_t i = 0; i < m_state_transitions_size; ++i)
+    {
+        if (m_state_transitions[i].src_state == cur_state &&
+            m_state_transitions[i].ret_code == state_ret)
+        {
+            return m_state_transitions[i].dst_state;
+        }
+    }
+
+    return cur_state;
+}
+
+void publish_snapshot(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    sm_state_E sm_state = (sm_state_E)ctx->relays.sm_state[relay_id];
+
+    ATOMIC_STORE(
+        ctx->relays.snapshot[relay_id],
+        SNAPSHOT_MAKE(to_relay_state(sm_state), to_relay_error(sm_state)));
+
+    wake_waiters(ctx);
+}
+
+// Lock-free as RELAY_ctx_get_state/error(). Relay in error stays there till deinit, so ALL fails
+// on first relay in error and ANY when all of them are.
+wait_E check_states(
+    RELAY_ctx_T* ctx,
+    const uint32_t* relay_ids,
+    uint32_t number,
+    RELAY_state_E state,
+    RELAY_wait_E mode)
+{
+    uint32_t relays_number = ATOMIC_LOAD(ctx->relays_number);
+    uint32_t* snapshots = ATOMIC_LOAD(ctx->relays.snapshot);
+    uint32_t done = 0, failed = 0;
+
+    if (relays_number == 0) return wait_FAILED;
+
+    for (uint32_t i = 0; i < number; ++i)
+    {
+        if (relay_ids[i] >= relays_number)
+        {
+            ++failed;
+            continue;
+        }
+
+        uint32_t snapshot = ATOMIC_LOAD(snapshots[relay_ids[i]]);
+
+        if (SNAPSHOT_ERROR(snapshot) != RELAY_error_NO)
+            ++failed;
+        else if (SNAPSHOT_STATE(snapshot) == state)
+            ++done;
+    }
+
+    if (mode == RELAY_wait_ANY)
+    {
+        if (done != 0) return wait_DONE;
+        if (failed == number) return wait_FAILED;
+    }
+    else
+    {
+        if (failed != 0) return wait_FAILED;
+        if (done == number) return wait_DONE;
+    }
+
+    return wait_PENDING;
+}
+
+// Waiter is rare, so state machine takes wait lock only when there is one
+void wake_waiters(RELAY_ctx_T* ctx)
+{
+    ATOMIC_FENCE(); // pairs with RELAY_ctx_wait_states(): waiter is seen or it sees new state
+
+    if (ATOMIC_LOAD(ctx->waiters) == 0) return;
+
+    RELAY_LOCK(ctx->wait_lock);
+    RELAY_COND_BROADCAST(ctx->wait_cond);
+    RELAY_UNLOCK(ctx->wait_lock);
+}
+
+RELAY_state_E to_relay_state(sm_state_E sm_state)
+{
+    switch (sm_state)
+    {
+    case sm_state_NOT_INIT:
+    default:
+        return RELAY_state_NOT_INIT;
+
+    case sm_state_OPEN:
+    case sm_state_OPEN_TO_CLOSE: // fine question, can be clarified
+    case sm_state_ERROR_CONST_OPEN:
+        return RELAY_state_OPEN;
+
+    case sm_state_CLOSE:
+    case sm_state_CLOSE_TO_OPEN: // fine question, can be clarified
+    case sm_state_ERROR_WELDED:
+        return RELAY_state_CLOSE;
+    }
+}
+
+RELAY_error_E to_relay_error(sm_state_E sm_state)
+{
+    switch (sm_state)
+    {
+    case sm_state_NOT_INIT:
+    case sm_state_OPEN:
+    case sm_state_OPEN_TO_CLOSE:
+    case sm_state_CLOSE:
+    case sm_state_CLOSE_TO_OPEN:
+    default:
+        return RELAY_error_NO;
+
+    case sm_state_ERROR_CONST_OPEN:
+        return RELAY_error_CONSTANTLY_OPEN;
+
+    case sm_state_ERROR_WELDED:
+        return RELAY_error_WELDED;
+    }
+}
+
+static void close(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    DO_state_E close_state =
+        ctx->config[relay_id].type == RELAY_type_NO ? DO_state_ON : DO_state_OFF;
+
+    set_output(ctx, relay_id, close_state);
+}
+
+static void open(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    DO_state_E open_state =
+        ctx->config[relay_id].type == RELAY_type_NO ? DO_state_OFF : DO_state_ON;
+
+    set_output(ctx, relay_id, open_state);
+}
+
+static void set_output(RELAY_ctx_T* ctx, uint32_t relay_id, DO_state_E state)
+{
+    DO_index_E index = ctx->config[relay_id].control_index;
+    DO_mask_T bit = (DO_mask_T)1u << (index % DO_PORT_WIDTH);
+
+    if (m_batch == NULL || m_batch->ctx != ctx)
+    {
+        ctx->hal.set_outputs(
+            ctx->hal.arg, index / DO_PORT_WIDTH, bit, state == DO_state_ON ? bit : 0);
+        return;
+    }
+
+    m_batch->mask[index / DO_PORT_WIDTH] |= bit;
+
+    if (state == DO_state_ON)
+        m_batch->states[index / DO_PORT_WIDTH] |= bit;
+    else
+        m_batch->states[index / DO_PORT_WIDTH] &= ~bit;
+}
+
+static CLOCK_ticks_T command_time(RELAY_ctx_T* ctx)
+{
+    return m_batch != NULL && m_batch->ctx == ctx ? m_batch->now : get_ticks(ctx);
+}
+
+// Feedback confirming transition is stable when it does so on each pass for RELAY_SETTLE_MS, so
+// contact bounce doesn't complete transition
+bool is_settled(RELAY_ctx_T* ctx, uint32_t relay_id, bool confirms)
+{
+    if (!confirms)
+    {
+        ctx->relays.flags[relay_id] &= (uint8_t)~FLAG_SETTLING;
+        return false;
+    }
+
+    if (!(ctx->relays.flags[relay_id] & FLAG_SETTLING))
+    {
+        ctx->relays.flags[relay_id] |= FLAG_SETTLING;
+        ctx->relays.settle_time[relay_id] =
+            ctx->sweep.now + CLOCK_MS_TO_TICKS(RELAY_SETTLE_MS);
+    }
+
+    return CLOCK_IS_DUE(ctx->relays.settle_time[relay_id], ctx->sweep.now);
+}
+
+// Due edge of switching pattern, verdict is given on RELAY_routine sample time as for switching.
+// Next edge follows after on phase of close edge or off phase of open one, counted from schedule
+// of this edge, so pattern doesn't drift, or from now when relay was late to switch.
+bool take_pattern_edge(RELAY_ctx_T* ctx, uint32_t relay_id, bool closing)
+{
+    pattern_T* pattern = &ctx->relays.patterns[relay_id];
+
+    if (!(ctx->relays.flags[relay_id] & FLAG_PATTERN)) return false;
+    if (!CLOCK_IS_DUE(pattern->next_edge, ctx->sweep.now)) return false;
+
+    CLOCK_ticks_T phase = CLOCK_MS_TO_TICKS(closing ? pattern->on_ms : pattern->off_ms);
+
+    pattern->next_edge += phase;
+    if (CLOCK_IS_DUE(pattern->next_edge, ctx->sweep.now))
+    {
+        pattern->next_edge = ctx->sweep.now + phase;
+    }
+
+    // last on phase ends, relay is left open
+    if (!closing && pattern->remaining != 0 && --pattern->remaining == 0)
+    {
+        ctx->relays.flags[relay_id] &= (uint8_t)~FLAG_PATTERN;
+    }
+
+    return true;
+}
+
+// Feedback state from current RELAY_routine pass sample
+bool is_closed(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    uint32_t index = ctx->relays.feedback[relay_id];
+
+    return (ctx->sweep.inputs[index / DI_PORT_WIDTH] >> (index % DI_PORT_WIDTH)) & 1u;
+}
+
+// State or error notification fired by verdict of state machine, posted for state relay got to.
+// Switching relay still posts one of stable state it started from, as next verdict waits for it.
+// Returns false while it waits for room in queue.
+bool post_fired(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    uint8_t* flags = &ctx->relays.flags[relay_id];
+    notification_E kind = notification_STATE;
+    uint32_t value;
+
+    if (!(*flags & (FLAG_FIRE_STATE | FLAG_FIRE_ERROR))) return true;
+
+    switch ((sm_state_E)ctx->relays.sm_state[relay_id])
+    {
+    case sm_state_OPEN:
+    case sm_state_OPEN_TO_CLOSE:
+        value = RELAY_state_OPEN;
+        break;
+    case sm_state_CLOSE:
+    case sm_state_CLOSE_TO_OPEN:
+        value = RELAY_state_CLOSE;
+        break;
+    case sm_state_ERROR_CONST_OPEN:
+        kind = notification_ERROR;
+        value = RELAY_error_CONSTANTLY_OPEN;
+        break;
+    case sm_state_ERROR_WELDED:
+        kind = notification_ERROR;
+        value = RELAY_error_WELDED;
+        break;
+    default: // not inited or deinited, nothing to deliver
+        return true;
+    }
+
+    if (!post_notification(ctx, relay_id, kind, value)) return false;
+
+    *flags &= (uint8_t)~(FLAG_FIRE_STATE | FLAG_FIRE_ERROR);
+
+    return true;
+}
+
+// Called under relay lock, so notifications of one relay are queued in order of state changes.
+// Returns false when queue is full, notification stays pending till dispatch makes room. Each
+// notification which had to wait is counted once.
+bool post_notification(RELAY_ctx_T* ctx, uint32_t relay_id, notification_E kind, uint32_t value)
+{
+    notification_T notification = {relay_id, kind, value};
+    uint8_t* flags = &ctx->relays.flags[relay_id];
+
+    if (!MPSC_push(&ctx->events, &notification))
+    {
+        if (!(*flags & FLAG_OVERFLOW)) ATOMIC_ADD(ctx->events_overflows, 1u);
+        *flags |= FLAG_OVERFLOW;
+        ATOMIC_STORE(ctx->events_full, true);
+
+        return false;
+    }
+
+    *flags &= (uint8_t)~FLAG_OVERFLOW;
+    ATOMIC_ADD(ctx->events_accepted, 1u);
+
+    return true;
+}
+
+uint16_t alloc_completion(RELAY_ctx_T* ctx)
+{
+    RELAY_LOCK(ctx->completions_lock);
+    uint16_t index = ctx->completions_free;
+    if (index != NO_COMPLETION) ctx->completions_free = ctx->completions[index].next;
+    RELAY_UNLOCK(ctx->completions_lock);
+
+    return index;
+}
+
+void free_completion(RELAY_ctx_T* ctx, uint16_t index)
+{
+    RELAY_LOCK(ctx->completions_lock);
+    ctx->completions[index].func = NULL;
+    ctx->completions[index].next = ctx->completions_free;
+    ctx->completions_free = index;
+    RELAY_UNLOCK(ctx->completions_lock);
+}
+
+// Give result to outstanding commands of relay, of event or all of them for NO_COMMAND
+void resolve_completions(RELAY_ctx_T* ctx, uint32_t relay_id, uint8_t event, RELAY_result_E result)
+{
+    for (uint16_t i = ctx->relays.completions[relay_id]; i != NO_COMPLETION;
+         i = ctx->completions[i].next)
+    {
+        completion_T* completion = &ctx->completions[i];
+
+        if (completion->result != NO_RESULT) continue;
+        if (event != NO_COMMAND && completion->event != event) continue;
+
+        completion->result = (uint8_t)result;
+        ctx->relays.flags[relay_id] |= FLAG_FIRE_COMPLETION;
+    }
+}
+
+// Completions follow state or error notification of relay, so they wait till it is posted. When
+// queue is full they are posted on next step, in order.
+void post_completions(RELAY_ctx_T* ctx, uint32_t relay_id)
+{
+    uint8_t* flags = &ctx->relays.flags[relay_id];
+    uint16_t* link = &ctx->relays.completions[relay_id];
+
+    if (!(*flags & FLAG_FIRE_COMPLETION) || (*flags & (FLAG_FIRE_STATE | FLAG_FIRE_ERROR))) return;
+
+    *flags &= (uint8_t)~FLAG_FIRE_COMPLETION;
+
+    while (*link != NO_COMPLETION)
+    {
+        uint16_t index = *link;
+        completion_T* completion = &ctx->completions[index];
+
+        if (completion->result == NO_RESULT)
+        {
+            link = &completion->next;
+            continue;
+        }
+
+        if (!post_notification(ctx, relay_id, notification_COMPLETION, index))
+        {
+            *flags |= FLAG_FIRE_COMPLETION;
+            return;
+        }
+
+        *link = completion->next;
+    }
+}
+
+// Take all completions at deinit, command without result is cancelled
+uint32_t take_completions(RELAY_ctx_T* ctx, completion_T* taken)
+{
+    uint32_t number = 0;
+
+    for (uint32_t i = 0; i < RELAY_COMPLETIONS_NUMBER; ++i)
+    {
+        completion_T* completion = &ctx->completions[i];
+
+        if (completion->func == NULL) continue;
+
+        taken[number] = *completion;
+        if (taken[number].result == NO_RESULT) taken[number].result = RELAY_result_CANCELLED;
+        ++number;
+
+        completion->func = NULL;
+    }
+
+    return number;
+}
+
+// One consumer at a time keeps per relay order. Instance lock is held only to pop notification and
+// copy its listeners, so listeners may call module API, including RELAY_deinit().
+uint32_t dispatch_notifications(RELAY_ctx_T* ctx, uint32_t max_number)
+{
+    uint32_t ret = 0;
+
+    if (!RELAY_TRYLOCK(ctx->dispatch_lock)) return 0;
+
+    while (ret < max_number)
+    {
+        notification_T notification;
+        listeners_T listeners = {.state.number = 0, .error.number = 0};
+        completion_T completion = {.func = NULL};
+        bool popped = false;
+
+        LOCK_SHARED(ctx->lock);
+        if (ctx->inited && MPSC_pop(&ctx->events, &notification))
+        {
+            if (notification.kind == notification_COMPLETION)
+            {
+                completion = ctx->completions[notification.value];
+                free_completion(ctx, (uint16_t)notification.value);
+            }
+            else
+            {
+                RELAY_LOCK(ctx->relays.locks[notification.relay_id]);
+                listeners = ctx->relays.listeners[notification.relay_id];
+                RELAY_UNLOCK(ctx->relays.locks[notification.relay_id]);
+            }
+            popped = true;
+        }
+        UNLOCK(ctx->lock);
+
+        if (!popped) break;
+
+        if (notification.kind == notification_COMPLETION)
+            completion.func(completion.relay_id, (RELAY_result_E)completion.result, completion.arg);
+        else if (notification.kind == notification_STATE)
+            notify_state_listeners(
+                ctx, notification.relay_id, (RELAY_state_E)notification.value, &listeners.state);
+        else
+            notify_error_listeners(
+                ctx, notification.relay_id, (RELAY_error_E)notification.value, &listeners.error);
+
+        ++ret;
+    }
+
+    RELAY_UNLOCK(ctx->dispatch_lock);
+
+    // relays with notifications left pending by full queue are stepped again to post them
+    if (ret != 0 && ATOMIC_LOAD(ctx->events_full) && ATOMIC_EXCHANGE(ctx->events_full, false))
+    {
+        wakeup(ctx, 0);
+    }
+
+    return ret;
+}
+
+void notify_error_listeners(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_error_E error, const error_listeners_T* listeners)
+{
+    for (uint32_t i = 0; i < listeners->number; ++i)
+    {
+        const error_listener_T* l = &listeners->items[i];
+
+        if (l->compat != NULL)
+            l->compat(relay_id, error);
+        else
+            l->func(ctx, relay_id, error, l->arg);
+    }
+}
+
+void notify_state_listeners(
+    RELAY_ctx_T* ctx, uint32_t relay_id, RELAY_state_E state, const state_listeners_T* listeners)
+{
+    for (uint32_t i = 0; i < listeners->number; ++i)
+    {
+        const state_listener_T* l = &listeners->items[i];
+
+        if (l->compat != NULL)
+            l->compat(relay_id, state);
+        else
+            l->func(ctx, relay_id, state, l->arg);
+    }
+}
+
+void log_config(RELAY_ctx_T* ctx, uint32_t relays_number)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    if (ctx->config == NULL) return;
+
+    for (uint32_t i = 0; i < relays_number; ++i)
+    {
+        LOG("Relay[%d] config:", i);
+        LOG("  type: %s", ctx->config[i].type == RELAY_type_NO ? "NO" : "NC");
+        LOG("  control_index: %d", ctx->config[i].control_index);
+        LOG("  feedback_index: %d", ctx->config[i].feedback_index);
+        LOG("  response_ms: %d", ctx->config[i].response_ms);
+    }
+}
+
+void wakeup(RELAY_ctx_T* ctx, uint32_t delay_ms)
+{
+    if (ctx->hal.wakeup != NULL) ctx->hal.wakeup(ctx->hal.arg, delay_ms);
+}
+
+CLOCK_ticks_T get_ticks(RELAY_ctx_T* ctx)
+{
+    return ctx->hal.get_ticks != NULL ? ctx->hal.get_ticks(ctx->hal.arg) : CLOCK_getTicks();
+}
+
+//
+// Default instance bindings and compatibility layer: RELAY_* functions work on default instance
+//
+
+DI_mask_T board_get_inputs(void* arg, uint32_t port)
+{
+    (void)arg;
+
+    return DI_getInputs(port);
+}
+
+DI_mask_T board_get_changes(void* arg, uint32_t port)
+{
+    (void)arg;
+
+    return DI_getChanges(port);
+}
+
+// DI change wakes routine up, so relays on changed pins are checked without waiting period
+void board_changed(void)
+{
+    SCHEDULER_wakeup(RELAY_routine);
+}
+
+void board_set_outputs(void* arg, uint32_t port, DO_mask_T mask, DO_mask_T states)
+{
+    (void)arg;
+
+    DO_setOutputs(port, mask, states);
+}
+
+void board_wakeup(void* arg, uint32_t delay_ms)
+{
+    (void)arg;
+
+    if (delay_ms == 0)
+        SCHEDULER_wakeup(RELAY_routine);
+    else
+        SCHEDULER_wakeup_in(RELAY_routine, delay_ms);
+}
+
+bool RELAY_init(RELAY_config_T* config, uint32_t relays_number)
+{
+    LOG("%s()", __PRETTY_FUNCTION__);
+
+    if (relays_number > MAX_SUPPORTED_RELAYS_NUMBER) return false;
+
+    return init(&m_default_ctx, config, relays_number, &m_relays_table);
+}
+
+bool RELAY_init_with_storage(
+    RELAY_config_T* config,
+    uint32_t relays_number,
+    void* storage,
+    size_t storage_size)
+{
+    return RELAY_ctx_init(&m_default_ctx, config, relays_number, storage, storage_size);
+}
+
+bool RELAY_is_inited()
+{
+    return RELAY_ctx_is_inited(&m_default_ctx);
+}
+
+void RELAY_deinit()
+{
+    DI_setChangeListener(NULL);
+    RELAY_ctx_deinit(&m_default_ctx);
+}
+
+SCHEDULER_routine_state_E RELAY_routine(void)
+{
+    return RELAY_ctx_routine(&m_default_ctx);
+}
+
+bool RELAY_set_workers(uint32_t workers_number)
+{
+    return RELAY_ctx_set_workers(&m_default_ctx, workers_number);
+}
+
+// hal is read by routine under shared lock, so it is switched under exclusive one
+void RELAY_set_change_checks(bool enabled)
+{
+    LOCK(m_default_ctx.lock);
+    m_default_ctx.hal.get_changes = enabled ? board_get_changes : NULL;
+    UNLOCK(m_default_ctx.lock);
+
+    DI_setChangeListener(enabled ? board_changed : NULL);
+
+    LOG("%s(enabled: %d)", __PRETTY_FUNCTION__, enabled);
+}
+
+RELAY_command_E RELAY_open(uint32_t relay_id)
+{
+    return RELAY_ctx_open(&m_default_ctx, relay_id);
+}
+
+RELAY_command_E RELAY_close(uint32_t relay_id)
+{
+    return RELAY_ctx_close(&m_default_ctx, relay_id);
+}
+
+RELAY_command_E RELAY_open_with_completion(
+    uint32_t relay_id, RELAY_completion_func_T func, void* arg)
+{
+    return RELAY_ctx_open_with_completion(&m_default_ctx, relay_id, func, arg);
+}
+
+RELAY_command_E RELAY_close_with_completion(
+    uint32_t relay_id, RELAY_completion_func_T func, void* arg)
+{
+    return RELAY_ctx_close_with_completion(&m_default_ctx, relay_id, func, arg);
+}
+
+uint32_t RELAY_open_many(const uint32_t* relay_ids, uint32_t number)
+{
+    return RELAY_ctx_open_many(&m_default_ctx, relay_ids, number);
+}
+
+uint32_t RELAY_close_many(const uint32_t* relay_ids, uint32_t number)
+{
+    return RELAY_ctx_close_many(&m_default_ctx, relay_ids, number);
+}
+
+bool RELAY_open_async(uint32_t relay_id)
+{
+    return RELAY_ctx_open_async(&m_default_ctx, relay_id);
+}
+
+bool RELAY_close_async(uint32_t relay_id)
+{
+    return RELAY_ctx_close_async(&m_default_ctx, relay_id);
+}
+
+bool RELAY_open_at(uint32_t relay_id, CLOCK_ticks_T at, RELAY_timer_id_T* timer_id)
+{
+    return RELAY_ctx_open_at(&m_default_ctx, relay_id, at, timer_id);
+}
+
+bool RELAY_close_at(uint32_t relay_id, CLOCK_ticks_T at, RELAY_timer_id_T* timer_id)
+{
+    return RELAY_ctx_close_at(&m_default_ctx, relay_id, at, timer_id);
+}
+
+bool RELAY_open_after(uint32_t relay_id, uint32_t delay_ms, RELAY_timer_id_T* timer_id)
+{
+    return RELAY_ctx_open_after(&m_default_ctx, relay_id, delay_ms, timer_id);
+}
+
+bool RELAY_close_after(uint32_t relay_id, uint32_t delay_ms, RELAY_timer_id_T* timer_id)
+{
+    return RELAY_ctx_close_after(&m_default_ctx, relay_id, delay_ms, timer_id);
+}
+
+bool RELAY_cancel_timer(RELAY_timer_id_T timer_id)
+{
+    return RELAY_ctx_cancel_timer(&m_default_ctx, timer_id);
+}
+
+uint32_t RELAY_get_pending_timers(void)
+{
+    return RELAY_ctx_get_pending_timers(&m_default_ctx);
+}
+
+bool RELAY_start_pattern(uint32_t relay_id, const RELAY_pattern_T* pattern)
+{
+    return RELAY_ctx_start_pattern(&m_default_ctx, relay_id, pattern);
+}
+
+bool RELAY_pulse(uint32_t relay_id, uint32_t on_ms)
+{
+    return RELAY_ctx_pulse(&m_default_ctx, relay_id, on_ms);
+}
+
+bool RELAY_stop_pattern(uint32_t relay_id)
+{
+    return RELAY_ctx_stop_pattern(&m_default_ctx, relay_id);
+}
+
+bool RELAY_is_pattern_running(uint32_t relay_id)
+{
+    return RELAY_ctx_is_pattern_running(&m_default_ctx, relay_id);
+}
+
+bool RELAY_wait_state(uint32_t relay_id, RELAY_state_E state, uint32_t timeout_ms)
+{
+    return RELAY_wait_states(&relay_id, 1u, state, RELAY_wait_ALL, timeout_ms);
+}
+
+bool RELAY_wait_states(
+    const uint32_t* relay_ids,
+    uint32_t number,
+    RELAY_state_E state,
+    RELAY_wait_E mode,
+    uint32_t timeout_ms)
+{
+    if (CLOCK_getSource() != CLOCK_source_VIRTUAL)
+    {
+        return RELAY_ctx_wait_states(&m_default_ctx, relay_ids, number, state, mode, timeout_ms);
+    }
+
+    // no scheduler thread on virtual clock, routines are run as waiting thread advances time.
+    // States change in routine calls only, so time jumps from one routine deadline to next one.
+    for (uint32_t ms = 0;;)
+    {
+        wait_E ret = check_states(&m_default_ctx, relay_ids, number, state, mode);
+
+        if (ret != wait_PENDING || ms >= timeout_ms) return ret == wait_DONE;
+
+        ms += SCHEDULER_advance_next(timeout_ms - ms);
+    }
+}
+
+void RELAY_get_queue_stats(RELAY_queue_stats_T* stats)
+{
+    RELAY_ctx_get_queue_stats(&m_default_ctx, stats);
+}
+
+RELAY_state_E RELAY_get_state(uint32_t relay_id)
+{
+    return RELAY_ctx_get_state(&m_default_ctx, relay_id);
+}
+
+RELAY_error_E RELAY_get_error(uint32_t relay_id)
+{
+    return RELAY_ctx_get_error(&m_default_ctx, relay_id);
+}
+
+bool RELAY_add_state_listener(
+    uint32_t relay_id,
+    RELAY_state_listener_func_T func,
+    RELAY_listener_id_T* listener_id)
+{
+    return add_state_listener(
+        &m_default_ctx, relay_id, (state_listener_T){NULL, func, NULL}, listener_id);
+}
+
+bool RELAY_add_error_listener(
+    uint32_t relay_id,
+    RELAY_error_listener_func_T func,
+    RELAY_listener_id_T* listener_id)
+{
+    return add_error_listener(
+        &m_default_ctx, relay_id, (error_listener_T){NULL, func, NULL}, listener_id);
+}
+
+bool RELAY_set_event_pump(bool enabled)
+{
+    return RELAY_ctx_set_event_pump(&m_default_ctx, enabled);
+}
+
+uint32_t RELAY_dispatch_events(uint32_t max_events)
+{
+    return RELAY_ctx_dispatch_events(&m_default_ctx, max_events);
+}
+
+void RELAY_get_event_stats(RELAY_queue_stats_T* stats)
+{
+    RELAY_ctx_get_event_stats(&m_default_ctx, stats);
 }
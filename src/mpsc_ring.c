@@ -0,0 +1,101 @@
+#include "mpsc_ring.h"
+#include <string.h>
+
+// cell starts with sequence number, element follows aligned to 8 bytes
+enum {SEQUENCE_SIZE = 8u};
+
+static uint32_t get_cell_size(uint32_t element_size);
+
+size_t MPSC_get_storage_size(uint32_t capacity, uint32_t element_size)
+{
+    return MPSC_STORAGE_SIZE(capacity, element_size);
+}
+
+bool MPSC_init(MPSC_ring_T* ring, void* storage, uint32_t capacity, uint32_t element_size)
+{
+    if (capacity == 0 || (capacity & (capacity - 1u)) != 0) return false;
+
+    ring->cells = (uint8_t*)storage;
+    ring->cell_size = get_cell_size(element_size);
+    ring->element_size = element_size;
+    ring->mask = capacity - 1u;
+    ring->head = 0;
+    ring->tail = 0;
+
+    // cell at position pos is free for push when its sequence equals pos
+    for (uint32_t i = 0; i < capacity; ++i)
+    {
+        uint32_t* sequence = (uint32_t*)(ring->cells + (size_t)i * ring->cell_size);
+        __atomic_store_n(sequence, i, __ATOMIC_RELAXED);
+    }
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool MPSC_push(MPSC_ring_T* ring, const void* element)
+{
+    uint32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint8_t* cell;
+
+    for (;;)
+    {
+        cell = ring->cells + (size_t)(pos & ring->mask) * ring->cell_size;
+
+        uint32_t sequence = __atomic_load_n((uint32_t*)cell, __ATOMIC_ACQUIRE);
+        int diff = (int)(sequence - pos);
+
+        if (diff == 0)
+        {
+            // cell is free, reserve it
+            if (__atomic_compare_exchange_n(
+                    &ring->head, &pos, pos + 1u, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+            return false; // full, cell still holds element of previous lap
+        else
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    }
+
+    memcpy(cell + SEQUENCE_SIZE, element, ring->element_size);
+
+    // publish element to consumer
+    __atomic_store_n((uint32_t*)cell, pos + 1u, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool MPSC_pop(MPSC_ring_T* ring, void* element)
+{
+    uint32_t pos = ring->tail;
+    uint8_t* cell = ring->cells + (size_t)(pos & ring->mask) * ring->cell_size;
+
+    uint32_t sequence = __atomic_load_n((uint32_t*)cell, __ATOMIC_ACQUIRE);
+
+    if (sequence != pos + 1u) return false; // empty or element is still being written
+
+    memcpy(element, cell + SEQUENCE_SIZE, ring->element_size);
+
+    // free cell for push on next lap
+    __atomic_store_n((uint32_t*)cell, pos + ring->mask + 1u, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->tail, pos + 1u, __ATOMIC_RELAXED);
+
+    return true;
+}
+
+uint32_t MPSC_get_depth(const MPSC_ring_T* ring)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    return head - tail;
+}
+
+uint32_t get_cell_size(uint32_t element_size)
+{
+    return SEQUENCE_SIZE + ((element_size + 7u) & ~7u);
+}
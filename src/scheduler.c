@@ -1,38 +1,446 @@
 #include "scheduler.h"
+#include "mdl_clock.h"
 #include <pthread.h>
-#include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 
-static SCHEDULER_rutine_T m_routine; // for now just one for RELAY client
-static pthread_t m_ptid;
+typedef struct routine
+{
+    SCHEDULER_rutine_T routine; // NULL - free slot
+    uint32_t period_ms;
+    uint32_t priority;
+
+    struct timespec period; // absolute time of next periodic call, advanced by period to not drift
+    struct timespec deadline; // absolute time of next call, periodic or requested earlier
+    bool pending; // call requested as soon as possible
+
+    uint32_t overruns;
+} routine_T;
+
+enum {NO_ROUTINE = MAX_SCHEDULER_ROUTINES};
+
+static routine_T m_routines[MAX_SCHEDULER_ROUTINES];
+static uint32_t m_running = NO_ROUTINE; // routine being called now
+static pthread_t m_ptid; // scheduler thread, or thread advancing virtual time
+static bool m_virtual; // routines are called by SCHEDULER_advance(), no scheduler thread
+static bool m_started; // SCHEDULER_run() was called
+static bool m_thread_running; // scheduler thread runs, it finishes when all routines are retired
+
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t m_cond_once = PTHREAD_ONCE_INIT;
+static pthread_cond_t m_cond; // scheduler thread wakeup, on monotonic clock
+static pthread_cond_t m_idle = PTHREAD_COND_INITIALIZER; // routine call or scheduler thread finished
+
+static void init_cond(void);
+static void start_thread(void);
+static routine_T* find_routine(SCHEDULER_rutine_T routine);
+static uint32_t pick_due_routine(const struct timespec* now);
+static bool get_earliest_deadline(struct timespec* deadline);
+static void call_routine(uint32_t id);
+static void run_virtual(const struct timespec* until);
+static void get_time(struct timespec* ts);
+static CLOCK_ticks_T timespec_diff_ticks(const struct timespec* from, const struct timespec* to);
+static void timespec_add_ms(struct timespec* ts, uint32_t ms);
+static bool timespec_less(const struct timespec* a, const struct timespec* b);
 
 void SCHEDULER_add(SCHEDULER_rutine_T routine)
 {
-    m_routine = routine;
+    SCHEDULER_add_routine(routine, SCHEDULER_PERIOD_MS, SCHEDULER_PRIORITY_NORMAL, NULL);
+}
+
+bool SCHEDULER_add_routine(
+    SCHEDULER_rutine_T routine,
+    uint32_t period_ms,
+    uint32_t priority,
+    SCHEDULER_routine_id_T* id)
+{
+    bool ret = false;
+
+    struct timespec now;
+    get_time(&now);
+
+    pthread_once(&m_cond_once, init_cond);
+
+    pthread_mutex_lock(&m_lock);
+    for (uint32_t i = 0; i < MAX_SCHEDULER_ROUTINES; ++i)
+    {
+        routine_T* r = &m_routines[i];
+
+        if (r->routine != NULL) continue;
+
+        r->period_ms = period_ms;
+        r->priority = priority;
+        r->period = now;
+        r->deadline = now;
+        r->pending = false;
+        r->overruns = 0;
+        __atomic_store_n(&r->routine, routine, __ATOMIC_RELEASE);
+
+        if (id) *id = i;
+        pthread_cond_signal(&m_cond);
+        ret = true;
+        break;
+    }
+
+    // scheduler thread has finished as all routines were retired, routine added later restarts it
+    if (ret && m_started && !m_virtual && !m_thread_running) start_thread();
+    pthread_mutex_unlock(&m_lock);
+
+    return ret;
+}
+
+bool SCHEDULER_remove(SCHEDULER_routine_id_T id)
+{
+    bool ret = false;
+
+    if (id >= MAX_SCHEDULER_ROUTINES) return ret;
+
+    pthread_once(&m_cond_once, init_cond);
+
+    pthread_mutex_lock(&m_lock);
+    if (m_routines[id].routine != NULL)
+    {
+        __atomic_store_n(&m_routines[id].routine, NULL, __ATOMIC_RELEASE);
+        pthread_cond_signal(&m_cond);
+        ret = true;
+    }
+
+    // routine may be removed from itself, then there is nothing to wait
+    while (m_running == id && !pthread_equal(pthread_self(), m_ptid))
+    {
+        pthread_cond_wait(&m_idle, &m_lock);
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return ret;
+}
+
+uint32_t SCHEDULER_get_overruns(SCHEDULER_routine_id_T id)
+{
+    uint32_t ret = 0;
+
+    if (id >= MAX_SCHEDULER_ROUTINES) return ret;
+
+    pthread_mutex_lock(&m_lock);
+    ret = m_routines[id].overruns;
+    pthread_mutex_unlock(&m_lock);
+
+    return ret;
 }
 
 void SCHEDULER_run(void)
 {
-    pthread_create(&m_ptid, NULL, scheduler, NULL);
+    pthread_once(&m_cond_once, init_cond);
+
+    pthread_mutex_lock(&m_lock);
+    m_virtual = CLOCK_getSource() == CLOCK_source_VIRTUAL;
+    m_started = true;
+
+    if (!m_virtual && !m_thread_running) start_thread();
+    pthread_mutex_unlock(&m_lock);
 }
 
 void SCHEDULER_wait(void)
 {
-    pthread_join(m_ptid, NULL);
+    if (m_virtual)
+    {
+        run_virtual(NULL);
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    while (m_thread_running)
+    {
+        pthread_cond_wait(&m_idle, &m_lock);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void SCHEDULER_advance(uint32_t ms)
+{
+    struct timespec until;
+    get_time(&until);
+    timespec_add_ms(&until, ms);
+
+    run_virtual(&until);
+}
+
+uint32_t SCHEDULER_advance_next(uint32_t max_ms)
+{
+    if (!m_virtual) return max_ms;
+
+    struct timespec start, until, deadline;
+    get_time(&start);
+    until = start;
+    timespec_add_ms(&until, max_ms);
+
+    // routines due now are called first, so next deadline is after now
+    run_virtual(&start);
+
+    pthread_mutex_lock(&m_lock);
+    bool scheduled = get_earliest_deadline(&deadline);
+    pthread_mutex_unlock(&m_lock);
+
+    if (!scheduled) return max_ms; // all routines are retired, nothing changes till max_ms
+
+    if (timespec_less(&until, &deadline)) deadline = until;
+
+    run_virtual(&deadline);
+
+    CLOCK_ticks_T ticks = timespec_diff_ticks(&start, &deadline);
+
+    return (uint32_t)((ticks + CLOCK_MS_TO_TICKS(1u) - 1u) / CLOCK_MS_TO_TICKS(1u));
+}
+
+void SCHEDULER_wakeup(SCHEDULER_rutine_T routine)
+{
+    routine_T* r = find_routine(routine);
+
+    // cheap path for bursts of commands, wakeup is already pending. Routine is found only after
+    // SCHEDULER_add_routine() has inited m_cond.
+    if (r == NULL || __atomic_load_n(&r->pending, __ATOMIC_RELAXED)) return;
+
+    pthread_mutex_lock(&m_lock);
+    if (r->routine == routine)
+    {
+        __atomic_store_n(&r->pending, true, __ATOMIC_RELAXED);
+        pthread_cond_signal(&m_cond);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void SCHEDULER_wakeup_in(SCHEDULER_rutine_T routine, uint32_t delay_ms)
+{
+    routine_T* r = find_routine(routine);
+
+    if (r == NULL) return;
+
+    struct timespec deadline;
+    get_time(&deadline);
+    timespec_add_ms(&deadline, delay_ms);
+
+    pthread_mutex_lock(&m_lock);
+    if (r->routine == routine && timespec_less(&deadline, &r->deadline))
+    {
+        r->deadline = deadline;
+        pthread_cond_signal(&m_cond);
+    }
+    pthread_mutex_unlock(&m_lock);
 }
 
 void* scheduler(void* arg)
 {
     (void)arg;
 
+    pthread_mutex_lock(&m_lock);
     for (;;)
     {
-        if (m_routine() == SCHEDULER_NOTHING_TODO) break;
+        struct timespec now;
+        get_time(&now);
+
+        uint32_t id = pick_due_routine(&now);
+
+        if (id != NO_ROUTINE)
+        {
+            call_routine(id);
+            continue;
+        }
+
+        struct timespec deadline;
+        if (!get_earliest_deadline(&deadline)) break; // all routines are retired
 
-        fflush(stdout);
-        struct timespec ts = {0, 100000000}; // 100 ms
-        nanosleep(&ts, &ts);
+        pthread_cond_timedwait(&m_cond, &m_lock, &deadline);
     }
+    m_thread_running = false;
+    pthread_cond_broadcast(&m_idle);
+    pthread_mutex_unlock(&m_lock);
 
     return NULL;
 }
+
+// Scheduler thread wakeup is timed on monotonic clock, it is inited before first signal
+void init_cond(void)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&m_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// Detached thread, SCHEDULER_wait() waits for m_thread_running, called with m_lock held
+void start_thread(void)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    m_thread_running = pthread_create(&m_ptid, &attr, scheduler, NULL) == 0;
+    pthread_attr_destroy(&attr);
+}
+
+routine_T* find_routine(SCHEDULER_rutine_T routine)
+{
+    for (uint32_t i = 0; i < MAX_SCHEDULER_ROUTINES; ++i)
+    {
+        if (__atomic_load_n(&m_routines[i].routine, __ATOMIC_ACQUIRE) == routine)
+        {
+            return &m_routines[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Highest priority routine from due ones, called with m_lock held
+uint32_t pick_due_routine(const struct timespec* now)
+{
+    uint32_t ret = NO_ROUTINE;
+
+    for (uint32_t i = 0; i < MAX_SCHEDULER_ROUTINES; ++i)
+    {
+        routine_T* r = &m_routines[i];
+
+        if (r->routine == NULL) continue;
+        if (!r->pending && timespec_less(now, &r->deadline)) continue;
+
+        if (ret == NO_ROUTINE || r->priority > m_routines[ret].priority) ret = i;
+    }
+
+    return ret;
+}
+
+// Earliest deadline of registered routines, called with m_lock held
+bool get_earliest_deadline(struct timespec* deadline)
+{
+    bool ret = false;
+
+    for (uint32_t i = 0; i < MAX_SCHEDULER_ROUTINES; ++i)
+    {
+        routine_T* r = &m_routines[i];
+
+        if (r->routine == NULL) continue;
+
+        if (!ret || timespec_less(&r->deadline, deadline))
+        {
+            *deadline = r->deadline;
+            ret = true;
+        }
+    }
+
+    return ret;
+}
+
+// Call routine and plan its next periodic call, called with m_lock held and releases it for call
+void call_routine(uint32_t id)
+{
+    routine_T* r = &m_routines[id];
+    SCHEDULER_rutine_T routine = r->routine;
+
+    struct timespec now;
+    get_time(&now);
+
+    if (!timespec_less(&now, &r->period))
+    {
+        timespec_add_ms(&r->period, r->period_ms);
+
+        while (!timespec_less(&now, &r->period))
+        {
+            timespec_add_ms(&r->period, r->period_ms);
+            ++r->overruns;
+        }
+    }
+
+    // routine may request earlier call by SCHEDULER_wakeup_in()
+    r->deadline = r->period;
+    __atomic_store_n(&r->pending, false, __ATOMIC_RELAXED);
+    m_running = id;
+    pthread_mutex_unlock(&m_lock);
+
+    SCHEDULER_routine_state_E state = routine();
+
+    pthread_mutex_lock(&m_lock);
+    m_running = NO_ROUTINE;
+    pthread_cond_broadcast(&m_idle);
+
+    if (state == SCHEDULER_NOTHING_TODO && r->routine == routine)
+    {
+        __atomic_store_n(&r->routine, NULL, __ATOMIC_RELEASE);
+    }
+}
+
+// Virtual time: due routines are called on calling thread, then clock jumps to next deadline
+// without waiting. NULL until - run till all routines are retired.
+void run_virtual(const struct timespec* until)
+{
+    if (!m_virtual) return;
+
+    pthread_mutex_lock(&m_lock);
+    m_ptid = pthread_self();
+    for (;;)
+    {
+        struct timespec now;
+        get_time(&now);
+
+        uint32_t id = pick_due_routine(&now);
+
+        if (id != NO_ROUTINE)
+        {
+            call_routine(id);
+            continue;
+        }
+
+        struct timespec deadline;
+        if (!get_earliest_deadline(&deadline)) break; // all routines are retired
+
+        if (until != NULL && timespec_less(until, &deadline))
+        {
+            CLOCK_advance(timespec_diff_ticks(&now, until));
+            break;
+        }
+
+        CLOCK_advance(timespec_diff_ticks(&now, &deadline));
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+// Scheduler time follows CLOCK_getTicks() when it is virtual
+void get_time(struct timespec* ts)
+{
+    if (CLOCK_getSource() == CLOCK_source_VIRTUAL)
+    {
+        CLOCK_ticks_T ticks = CLOCK_getTicks();
+
+        ts->tv_sec = (time_t)(ticks / CLOCK_MS_TO_TICKS(1000u));
+        ts->tv_nsec = (long)(ticks % CLOCK_MS_TO_TICKS(1000u)) * (long)CLOCK_NS_PER_TICK;
+    }
+    else
+        clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+// Clock ticks from earlier time to later one, rounded up
+CLOCK_ticks_T timespec_diff_ticks(const struct timespec* from, const struct timespec* to)
+{
+    long long ns = (long long)(to->tv_sec - from->tv_sec) * 1000000000LL;
+
+    ns += to->tv_nsec - from->tv_nsec;
+
+    return ns > 0 ? (CLOCK_ticks_T)((ns + CLOCK_NS_PER_TICK - 1) / CLOCK_NS_PER_TICK) : 0;
+}
+
+void timespec_add_ms(struct timespec* ts, uint32_t ms)
+{
+    ts->tv_sec += ms / 1000u;
+    ts->tv_nsec += (long)(ms % 1000u) * 1000000L;
+
+    if (ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_sec += 1;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+bool timespec_less(const struct timespec* a, const struct timespec* b)
+{
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
@@ -1,88 +1,565 @@
 #include "simu.h"
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "mdl_clock.h"
 #include "mdl_di.h"
 #include "mdl_do.h"
 
-static DI_state_E SIMU_inputs[DI_index_NUMBER];
-static SIMU_mode_E m_mode;
-static RELAY_config_T* m_config;
-static uint32_t m_relays_number;
+// Simulated relay contacts, one per DO pin. Feedback is not stored but evaluated at read time from
+// actuation timeline, so DI reads see delay and bounce as time passes. SIMU_routine() follows
+// timelines in progress to latch DI changes when they happen.
+typedef struct contacts
+{
+    SIMU_model_T model;
+    uint64_t random; // own generator state, faults don't depend on threads interleaving
+    CLOCK_ticks_T settle_at; // actuation end, contacts are in closed_to state
+    CLOCK_ticks_T bounce_end;
+    SIMU_fault_T fault;
+    uint16_t feedback; // DI pin reading contacts, NO_PIN if none
+    uint8_t type; // RELAY_type_E
+    bool pending; // timeline in progress, followed by SIMU_routine()
+    bool reported; // closed state of last DI change
+    bool commanded; // closed by control line
+    bool closed_from; // state before actuation
+    bool closed_to; // state after actuation, differs from commanded on fault
+} contacts_T;
 
-void SIMU_init(SIMU_mode_E mode, RELAY_config_T* config, uint32_t relays_number)
+enum {NO_CONTACTS = DO_index_NUMBER, NO_PIN = DI_index_NUMBER};
+
+// Simulated board: everything SIMU_ctx_* functions work on, so boards don't share any state
+struct SIMU_ctx
+{
+    SIMU_mode_E mode;
+    RELAY_config_T* config;
+    uint32_t relays_number;
+    uint64_t seed;
+    bool own_clock; // own virtual clock, otherwise CLOCK_getTicks() and scheduler are used
+    CLOCK_ticks_T now; // own virtual clock
+    contacts_T contacts[DO_index_NUMBER];
+    uint32_t feedback_contacts[DI_index_NUMBER]; // contacts read by DI pin or NO_CONTACTS
+    SIMU_stats_T stats;
+    DI_mask_T changes[DI_PORTS_NUMBER]; // DI changes latched for get_changes
+};
+
+// Default instance behind SIMU_* and DI_*/DO_* functions
+static SIMU_ctx_T m_default_simu = {.seed = 1u};
+
+// DI_getChangeFd() and DI_setChangeListener() of default instance
+static int m_change_fds[2] = {-1, -1}; // non-blocking pipe, byte is written on changes
+static DI_change_listener_T m_change_listener;
+
+static CLOCK_ticks_T get_now(SIMU_ctx_T* simu);
+static bool follow_contacts(SIMU_ctx_T* simu, CLOCK_ticks_T now, CLOCK_ticks_T* next);
+static bool is_closed(SIMU_ctx_T* simu, const contacts_T* c, CLOCK_ticks_T now);
+static void actuate(SIMU_ctx_T* simu, contacts_T* c, bool closed, CLOCK_ticks_T now);
+static uint32_t sample_delay(contacts_T* c);
+static bool happens(contacts_T* c, uint32_t ppm);
+static uint64_t next_random(uint64_t* state);
+static DI_state_E read_input(SIMU_ctx_T* simu, uint32_t index, CLOCK_ticks_T now);
+static DI_mask_T read_inputs(SIMU_ctx_T* simu, uint32_t port);
+static void write_output(SIMU_ctx_T* simu, uint32_t index, DO_state_E state);
+static void write_outputs(SIMU_ctx_T* simu, uint32_t port, DO_mask_T mask, DO_mask_T states);
+static DI_mask_T take_changes(SIMU_ctx_T* simu, uint32_t port);
+static void latch_change(SIMU_ctx_T* simu, uint32_t index);
+static contacts_T* find_contacts(SIMU_ctx_T* simu, uint32_t relay_id);
+static DI_mask_T hal_get_inputs(void* arg, uint32_t port);
+static void hal_set_outputs(void* arg, uint32_t port, DO_mask_T mask, DO_mask_T states);
+static DI_mask_T hal_get_changes(void* arg, uint32_t port);
+static CLOCK_ticks_T hal_get_ticks(void* arg);
+
+size_t SIMU_ctx_get_size(void)
+{
+    return sizeof(SIMU_ctx_T);
+}
+
+SIMU_ctx_T* SIMU_ctx_create(void* memory, size_t memory_size)
+{
+    if (memory == NULL || memory_size < sizeof(SIMU_ctx_T)) return NULL;
+
+    SIMU_ctx_T* simu = (SIMU_ctx_T*)memory;
+
+    *simu = (SIMU_ctx_T){.seed = 1u, .own_clock = true};
+
+    return simu;
+}
+
+void SIMU_ctx_init(
+    SIMU_ctx_T* simu, SIMU_mode_E mode, RELAY_config_T* config, uint32_t relays_number)
 {
     LOG("%s(mode: %s)",
         __PRETTY_FUNCTION__,
         mode == SIMU_mode_CORRECT ? "SIMU_mode_CORRECT" : "SIMU_mode_WRONG");
 
-    m_mode = mode;
-    m_config = config;
-    m_relays_number = relays_number;
+    simu->mode = mode;
+    simu->config = config;
+    simu->relays_number = relays_number;
+    simu->stats = (SIMU_stats_T){0};
+    ATOMIC_STORE(simu->now, 0);
+
+    for (uint32_t port = 0; port < DI_PORTS_NUMBER; ++port)
+    {
+        simu->changes[port] = 0;
+    }
+
+    for (uint32_t i = 0; i < DI_index_NUMBER; ++i)
+    {
+        simu->feedback_contacts[i] = NO_CONTACTS;
+    }
+
+    for (uint32_t i = 0; i < DO_index_NUMBER; ++i)
+    {
+        simu->contacts[i] = (contacts_T){
+            .model = {.delay = SIMU_delay_FIXED},
+            .random = simu->seed + i,
+            .settle_at = 0,
+            .bounce_end = 0,
+            .fault = {.type = SIMU_fault_NO, .since = 0},
+            .feedback = NO_PIN,
+            .type = RELAY_type_NO,
+        };
+    }
 
-    // Init feedback lines
-    for (uint32_t i = 0; i < m_relays_number; ++i)
+    // Init contacts de-energized: NO relay is open, NC one is closed
+    for (uint32_t i = 0; i < relays_number; ++i)
     {
-        DI_state_E state;
+        if (config[i].control_index >= (uint32_t)DO_index_NUMBER) continue;
 
-        if (config[i].feedback_index == RELAY_WO_FEEDBACK || config[i].feedback_index >= DI_index_NUMBER) break;
+        contacts_T* c = &simu->contacts[config[i].control_index];
+        bool closed = config[i].type == RELAY_type_NC;
 
-        if (mode == SIMU_mode_CORRECT)
+        c->type = (uint8_t)config[i].type;
+        c->commanded = c->closed_from = c->closed_to = c->reported = closed;
+
+        if (config[i].feedback_index < (uint32_t)DI_index_NUMBER)
         {
-            state = config[i].type == RELAY_type_NO ? DI_state_OFF : DI_state_ON;
+            simu->feedback_contacts[config[i].feedback_index] = config[i].control_index;
+            c->feedback = (uint16_t)config[i].feedback_index;
         }
-        else
+    }
+}
+
+void SIMU_ctx_set_seed(SIMU_ctx_T* simu, uint64_t seed)
+{
+    simu->seed = seed;
+}
+
+bool SIMU_ctx_set_model(SIMU_ctx_T* simu, uint32_t relay_id, const SIMU_model_T* model)
+{
+    contacts_T* c = find_contacts(simu, relay_id);
+
+    if (c == NULL) return false;
+
+    c->model = *model;
+
+    return true;
+}
+
+bool SIMU_ctx_get_fault(SIMU_ctx_T* simu, uint32_t relay_id, SIMU_fault_T* fault)
+{
+    contacts_T* c = find_contacts(simu, relay_id);
+
+    if (c == NULL) return false;
+
+    *fault = c->fault;
+
+    return true;
+}
+
+void SIMU_ctx_get_stats(SIMU_ctx_T* simu, SIMU_stats_T* stats)
+{
+    stats->actuations = __atomic_load_n(&simu->stats.actuations, __ATOMIC_RELAXED);
+    stats->welds = __atomic_load_n(&simu->stats.welds, __ATOMIC_RELAXED);
+    stats->stuck_opens = __atomic_load_n(&simu->stats.stuck_opens, __ATOMIC_RELAXED);
+}
+
+void SIMU_ctx_routine(SIMU_ctx_T* simu)
+{
+    CLOCK_ticks_T next;
+
+    (void)follow_contacts(simu, get_now(simu), &next);
+}
+
+void SIMU_ctx_advance(SIMU_ctx_T* simu, CLOCK_ticks_T ticks)
+{
+    ATOMIC_ADD(simu->now, ticks);
+}
+
+CLOCK_ticks_T SIMU_ctx_get_ticks(SIMU_ctx_T* simu)
+{
+    return get_now(simu);
+}
+
+void SIMU_ctx_get_hal(SIMU_ctx_T* simu, RELAY_hal_T* hal)
+{
+    *hal = (RELAY_hal_T){
+        .get_inputs = hal_get_inputs,
+        .set_outputs = hal_set_outputs,
+        .get_changes = hal_get_changes,
+        .wakeup = NULL,
+        .get_ticks = simu->own_clock ? hal_get_ticks : NULL,
+        .arg = simu,
+    };
+}
+
+//
+// Default instance: board DI/DO functions, scheduler routine and CLOCK_getTicks() time
+//
+
+void SIMU_init(SIMU_mode_E mode, RELAY_config_T* config, uint32_t relays_number)
+{
+    if (m_change_fds[0] < 0 && pipe(m_change_fds) == 0)
+    {
+        for (uint32_t i = 0; i < 2u; ++i)
         {
-            state = config[i].type == RELAY_type_NO ? DI_state_ON : DI_state_OFF;
+            fcntl(m_change_fds[i], F_SETFL, O_NONBLOCK);
+            fcntl(m_change_fds[i], F_SETFD, FD_CLOEXEC);
         }
-
-        SIMU_inputs[config[i].feedback_index] = state;
     }
+
+    SIMU_ctx_init(&m_default_simu, mode, config, relays_number);
+}
+
+void SIMU_set_seed(uint64_t seed)
+{
+    SIMU_ctx_set_seed(&m_default_simu, seed);
+}
+
+bool SIMU_set_model(uint32_t relay_id, const SIMU_model_T* model)
+{
+    return SIMU_ctx_set_model(&m_default_simu, relay_id, model);
+}
+
+bool SIMU_get_fault(uint32_t relay_id, SIMU_fault_T* fault)
+{
+    return SIMU_ctx_get_fault(&m_default_simu, relay_id, fault);
+}
+
+void SIMU_get_stats(SIMU_stats_T* stats)
+{
+    SIMU_ctx_get_stats(&m_default_simu, stats);
 }
 
 DI_state_E DI_getInputState(DI_index_E index)
 {
-    return SIMU_inputs[index];
+    return read_input(&m_default_simu, index, CLOCK_getTicks());
+}
+
+DI_mask_T DI_getInputs(uint32_t port)
+{
+    return read_inputs(&m_default_simu, port);
+}
+
+void DO_setOutputs(uint32_t port, DO_mask_T mask, DO_mask_T states)
+{
+    write_outputs(&m_default_simu, port, mask, states);
 }
 
 void DO_setOutputState(DO_index_E index, DO_state_E state)
 {
-    for (uint32_t i = 0; i < m_relays_number; ++i)
+    write_output(&m_default_simu, index, state);
+}
+
+SCHEDULER_routine_state_E SIMU_routine(void)
+{
+    CLOCK_ticks_T now = CLOCK_getTicks();
+    CLOCK_ticks_T next;
+    bool changed = follow_contacts(&m_default_simu, now, &next);
+
+    if (changed)
+    {
+        char byte = 1;
+        DI_change_listener_T listener = __atomic_load_n(&m_change_listener, __ATOMIC_ACQUIRE);
+
+        // write fails when pipe is full only, fd stays readable then
+        if (m_change_fds[1] >= 0) (void)!write(m_change_fds[1], &byte, sizeof(byte));
+
+        if (listener != NULL) listener();
+    }
+
+    if (next != now) SCHEDULER_wakeup_in(SIMU_routine, (uint32_t)CLOCK_TICKS_TO_MS(next - now));
+
+    return SCHEDULER_ACTIVE;
+}
+
+DI_mask_T DI_getChanges(uint32_t port)
+{
+    if (port >= DI_PORTS_NUMBER) return 0;
+
+    // fd is drained before changes are taken, change latched after that writes it again
+    if (port == 0 && m_change_fds[0] >= 0)
     {
-        if (m_config[i].feedback_index == RELAY_WO_FEEDBACK || m_config[i].feedback_index >= DI_index_NUMBER) break;
+        char bytes[64];
 
-        if (m_config[i].control_index == index)
+        while (read(m_change_fds[0], bytes, sizeof(bytes)) > 0)
         {
-            DI_state_E di_state;
+        }
+    }
 
-            if (m_mode == SIMU_mode_CORRECT)
-            {
-                if (m_config[i].type == RELAY_type_NO)
-                {
-                    di_state = state == DO_state_ON ? DI_state_ON : DI_state_OFF;
-                }
-                else
-                    di_state = state == DO_state_ON ? DI_state_OFF : DI_state_ON;
-            }
-            else
+    return take_changes(&m_default_simu, port);
+}
+
+int DI_getChangeFd(void)
+{
+    return m_change_fds[0];
+}
+
+void DI_setChangeListener(DI_change_listener_T listener)
+{
+    __atomic_store_n(&m_change_listener, listener, __ATOMIC_RELEASE);
+}
+
+void SIMU_sleep(uint32_t ms)
+{
+    if (CLOCK_getSource() == CLOCK_source_VIRTUAL)
+    {
+        SCHEDULER_advance(ms);
+
+        // time is not waited, so log of simulated period is output at once
+        TRACE_flush(stdout);
+    }
+    else
+        usleep(ms * 1000u);
+}
+
+CLOCK_ticks_T get_now(SIMU_ctx_T* simu)
+{
+    return simu->own_clock ? ATOMIC_LOAD(simu->now) : CLOCK_getTicks();
+}
+
+// Latch DI changes of contacts timelines in progress. Returns true when some DI changed, next is
+// tick at which timelines need to be followed again, now if none is in progress.
+bool follow_contacts(SIMU_ctx_T* simu, CLOCK_ticks_T now, CLOCK_ticks_T* next)
+{
+    bool changed = false;
+    bool waiting = false;
+
+    *next = now;
+
+    for (uint32_t i = 0; i < DO_index_NUMBER; ++i)
+    {
+        contacts_T* c = &simu->contacts[i];
+
+        if (!__atomic_load_n(&c->pending, __ATOMIC_ACQUIRE)) continue;
+
+        bool closed = is_closed(simu, c, now);
+
+        if (closed != c->reported)
+        {
+            c->reported = closed;
+            latch_change(simu, c->feedback);
+            changed = true;
+        }
+
+        if (CLOCK_IS_DUE(c->bounce_end, now))
+        {
+            __atomic_store_n(&c->pending, false, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        // contacts settle at settle_at, then may bounce each tick till bounce_end
+        CLOCK_ticks_T at = CLOCK_IS_DUE(c->settle_at, now) ? now + 1u : c->settle_at;
+
+        if (!waiting || (long long)(at - *next) < 0) *next = at;
+        waiting = true;
+    }
+
+    return changed;
+}
+
+// Feedback line is ON when contacts are closed, inverted in SIMU_mode_WRONG
+DI_state_E read_input(SIMU_ctx_T* simu, uint32_t index, CLOCK_ticks_T now)
+{
+    uint32_t contacts = simu->feedback_contacts[index];
+
+    if (contacts == NO_CONTACTS) return DI_state_OFF;
+
+    bool closed = is_closed(simu, &simu->contacts[contacts], now);
+
+    if (simu->mode == SIMU_mode_WRONG) closed = !closed;
+
+    return closed ? DI_state_ON : DI_state_OFF;
+}
+
+DI_mask_T read_inputs(SIMU_ctx_T* simu, uint32_t port)
+{
+    DI_mask_T mask = 0;
+    CLOCK_ticks_T now = get_now(simu);
+
+    for (uint32_t i = 0; i < DI_PORT_WIDTH; ++i)
+    {
+        uint32_t index = port * DI_PORT_WIDTH + i;
+
+        if (index >= DI_index_NUMBER) break;
+
+        if (read_input(simu, index, now) == DI_state_ON) mask |= (DI_mask_T)1u << i;
+    }
+
+    return mask;
+}
+
+void write_outputs(SIMU_ctx_T* simu, uint32_t port, DO_mask_T mask, DO_mask_T states)
+{
+    for (uint32_t i = 0; i < DO_PORT_WIDTH; ++i)
+    {
+        uint32_t index = port * DO_PORT_WIDTH + i;
+
+        if (index >= DO_index_NUMBER) break;
+
+        if (mask & ((DO_mask_T)1u << i))
+        {
+            write_output(simu, index, (states >> i) & 1u ? DO_state_ON : DO_state_OFF);
+        }
+    }
+}
+
+void write_output(SIMU_ctx_T* simu, uint32_t index, DO_state_E state)
+{
+    if (index >= DO_index_NUMBER) return;
+
+    contacts_T* c = &simu->contacts[index];
+
+    // NO contacts close when coil is energized, NC ones open
+    bool closed = (state == DO_state_ON) == (c->type == RELAY_type_NO);
+
+    if (closed != c->commanded) actuate(simu, c, closed, get_now(simu));
+}
+
+DI_mask_T take_changes(SIMU_ctx_T* simu, uint32_t port)
+{
+    return port < DI_PORTS_NUMBER ? ATOMIC_EXCHANGE(simu->changes[port], 0) : 0;
+}
+
+contacts_T* find_contacts(SIMU_ctx_T* simu, uint32_t relay_id)
+{
+    if (relay_id >= simu->relays_number) return NULL;
+
+    uint32_t index = simu->config[relay_id].control_index;
+
+    return index < (uint32_t)DO_index_NUMBER ? &simu->contacts[index] : NULL;
+}
+
+void latch_change(SIMU_ctx_T* simu, uint32_t index)
+{
+    DI_mask_T bit = (DI_mask_T)1u << (index % DI_PORT_WIDTH);
+
+    __atomic_fetch_or(&simu->changes[index / DI_PORT_WIDTH], bit, __ATOMIC_RELEASE);
+}
+
+bool is_closed(SIMU_ctx_T* simu, const contacts_T* c, CLOCK_ticks_T now)
+{
+    if (!CLOCK_IS_DUE(c->settle_at, now)) return c->closed_from;
+
+    if (CLOCK_IS_DUE(c->bounce_end, now)) return c->closed_to;
+
+    // bouncing contacts, pattern changes each tick and differs between contacts
+    uint64_t bounce = (now ^ (uint64_t)(c - simu->contacts) << 32) * 0x9E3779B97F4A7C15ull;
+
+    return (bounce >> 63) != 0;
+}
+
+void actuate(SIMU_ctx_T* simu, contacts_T* c, bool closed, CLOCK_ticks_T now)
+{
+    c->closed_from = is_closed(simu, c, now);
+    c->commanded = closed;
+    c->settle_at = now + CLOCK_MS_TO_TICKS(sample_delay(c));
+    c->bounce_end = c->settle_at + CLOCK_MS_TO_TICKS(c->model.bounce_ms);
+    c->closed_to = closed;
+    c->fault = (SIMU_fault_T){SIMU_fault_NO, c->settle_at};
+
+    if (closed && happens(c, c->model.stuck_open_ppm))
+    {
+        c->closed_to = false;
+        c->fault.type = SIMU_fault_STUCK_OPEN;
+        __atomic_fetch_add(&simu->stats.stuck_opens, 1u, __ATOMIC_RELAXED);
+    }
+    else if (!closed && happens(c, c->model.weld_ppm))
+    {
+        c->closed_to = true;
+        c->fault.type = SIMU_fault_WELDED;
+        __atomic_fetch_add(&simu->stats.welds, 1u, __ATOMIC_RELAXED);
+    }
+
+    __atomic_fetch_add(&simu->stats.actuations, 1u, __ATOMIC_RELAXED);
+
+    // DI changes of actuation are latched by SIMU_routine() as they happen, instance with own
+    // clock is followed by SIMU_ctx_routine() calls of its driver
+    if (c->feedback != NO_PIN)
+    {
+        __atomic_store_n(&c->pending, true, __ATOMIC_RELEASE);
+
+        if (!simu->own_clock)
+        {
+            SCHEDULER_wakeup_in(SIMU_routine, (uint32_t)CLOCK_TICKS_TO_MS(c->settle_at - now));
+        }
+    }
+}
+
+uint32_t sample_delay(contacts_T* c)
+{
+    const SIMU_model_T* m = &c->model;
+    double delay = m->delay_ms;
+
+    switch (m->delay)
+    {
+    case SIMU_delay_FIXED:
+    default:
+        break;
+
+    case SIMU_delay_UNIFORM:
+        delay += (double)(next_random(&c->random) % (2u * m->spread_ms + 1u)) - m->spread_ms;
+        break;
+
+    case SIMU_delay_NORMAL:
+        // Irwin-Hall: sum of 12 uniform samples is close to normal with variance 1
+        {
+            double sum = 0;
+
+            for (uint32_t i = 0; i < 12u; ++i)
             {
-                if (m_config[i].type == RELAY_type_NO)
-                {
-                    di_state = state == DO_state_ON ? DI_state_OFF : DI_state_ON;
-                }
-                else
-                    di_state = state == DO_state_ON ? DI_state_ON : DI_state_OFF;
+                sum += (double)(next_random(&c->random) >> 11) * (1.0 / 9007199254740992.0);
             }
 
-            SIMU_inputs[index] = di_state;
+            delay += (sum - 6.0) * m->spread_ms;
         }
+        break;
     }
+
+    return delay > 0 ? (uint32_t)(delay + 0.5) : 0;
+}
+
+bool happens(contacts_T* c, uint32_t ppm)
+{
+    return ppm != 0 && next_random(&c->random) % 1000000u < ppm;
+}
+
+// splitmix64, any state including 0 is valid
+uint64_t next_random(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+    return z ^ (z >> 31);
 }
 
-CLOCK_ticks_T CLOCK_getTicks()
+DI_mask_T hal_get_inputs(void* arg, uint32_t port)
 {
-    static CLOCK_ticks_T ticks = 0;
+    return read_inputs((SIMU_ctx_T*)arg, port);
+}
 
-    ++ticks;
+void hal_set_outputs(void* arg, uint32_t port, DO_mask_T mask, DO_mask_T states)
+{
+    write_outputs((SIMU_ctx_T*)arg, port, mask, states);
+}
 
-    return ticks;
+DI_mask_T hal_get_changes(void* arg, uint32_t port)
+{
+    return take_changes((SIMU_ctx_T*)arg, port);
+}
+
+CLOCK_ticks_T hal_get_ticks(void* arg)
+{
+    return get_now((SIMU_ctx_T*)arg);
 }
@@ -0,0 +1,212 @@
+#include "timing_wheel.h"
+#include <stddef.h>
+
+// Timer lists are circular with slot head as sentinel
+enum {SLOT_MASK = WHEEL_SLOTS - 1u};
+enum {FAR_SLOT = WHEEL_LEVELS * WHEEL_SLOTS}; // expiry beyond top level, re-added when it wraps
+enum {TOP_BITS = WHEEL_LEVELS * WHEEL_SLOT_BITS}; // ticks spanned by all levels
+
+static void place(WHEEL_T* wheel, WHEEL_timer_T* timer);
+static void unlink(WHEEL_T* wheel, WHEEL_timer_T* timer);
+static void cascade(WHEEL_T* wheel, uint32_t slot);
+static bool is_aligned(CLOCK_ticks_T tick, uint32_t bits);
+
+void WHEEL_init(WHEEL_T* wheel, CLOCK_ticks_T now)
+{
+    wheel->now = now;
+    wheel->pending = 0;
+
+    for (uint32_t level = 0; level < WHEEL_LEVELS; ++level)
+    {
+        wheel->occupied[level] = 0;
+    }
+
+    for (uint32_t slot = 0; slot <= FAR_SLOT; ++slot)
+    {
+        wheel->slots[slot].next = &wheel->slots[slot];
+        wheel->slots[slot].prev = &wheel->slots[slot];
+    }
+}
+
+void WHEEL_init_timer(WHEEL_timer_T* timer)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->slot = WHEEL_NOT_PENDING;
+}
+
+void WHEEL_add(WHEEL_T* wheel, WHEEL_timer_T* timer, CLOCK_ticks_T expires)
+{
+    // slot of wheel time is expired already
+    timer->expires = expires > wheel->now ? expires : wheel->now + 1u;
+
+    place(wheel, timer);
+    ++wheel->pending;
+}
+
+bool WHEEL_remove(WHEEL_T* wheel, WHEEL_timer_T* timer)
+{
+    if (timer->slot == WHEEL_NOT_PENDING) return false;
+
+    unlink(wheel, timer);
+    --wheel->pending;
+
+    return true;
+}
+
+bool WHEEL_is_pending(const WHEEL_timer_T* timer)
+{
+    return timer->slot != WHEEL_NOT_PENDING;
+}
+
+uint32_t WHEEL_advance(WHEEL_T* wheel, CLOCK_ticks_T now, WHEEL_expire_func_T func, void* arg)
+{
+    uint32_t expired = 0;
+    CLOCK_ticks_T tick;
+
+    // jump from one tick with work to the next one, ticks between them have nothing to do
+    while (wheel->now < now && WHEEL_get_next(wheel, &tick) && tick <= now)
+    {
+        wheel->now = tick;
+
+        // timers of higher level slot starting at tick move down, top level first as lower level
+        // slot may start at tick too
+        if (is_aligned(tick, TOP_BITS)) cascade(wheel, FAR_SLOT);
+
+        for (uint32_t level = WHEEL_LEVELS - 1u; level > 0; --level)
+        {
+            uint32_t bits = level * WHEEL_SLOT_BITS;
+
+            if (is_aligned(tick, bits))
+            {
+                cascade(wheel, level * WHEEL_SLOTS + (uint32_t)((tick >> bits) & SLOT_MASK));
+            }
+        }
+
+        WHEEL_timer_T* head = &wheel->slots[tick & SLOT_MASK];
+
+        while (head->next != head)
+        {
+            WHEEL_timer_T* timer = head->next;
+
+            unlink(wheel, timer);
+            --wheel->pending;
+            ++expired;
+
+            func(timer, arg);
+        }
+    }
+
+    if (wheel->now < now) wheel->now = now;
+
+    return expired;
+}
+
+bool WHEEL_get_next(const WHEEL_T* wheel, CLOCK_ticks_T* tick)
+{
+    bool found = false;
+
+    if (wheel->pending == 0) return false;
+
+    // timers are in slots after one of wheel time only, so first occupied slot past it is next
+    for (uint32_t level = 0; level < WHEEL_LEVELS; ++level)
+    {
+        uint32_t bits = level * WHEEL_SLOT_BITS;
+        uint32_t current = (uint32_t)((wheel->now >> bits) & SLOT_MASK);
+        uint64_t later = wheel->occupied[level] & ~((2ull << current) - 1u);
+
+        if (later == 0) continue;
+
+        uint32_t upper = bits + WHEEL_SLOT_BITS;
+        CLOCK_ticks_T start =
+            ((wheel->now >> upper) << upper) | ((CLOCK_ticks_T)__builtin_ctzll(later) << bits);
+
+        if (!found || start < *tick) *tick = start;
+        found = true;
+    }
+
+    const WHEEL_timer_T* far = &wheel->slots[FAR_SLOT];
+
+    if (far->next != far)
+    {
+        CLOCK_ticks_T wrap = ((wheel->now >> TOP_BITS) + 1u) << TOP_BITS;
+
+        if (!found || wrap < *tick) *tick = wrap;
+        found = true;
+    }
+
+    return found;
+}
+
+uint32_t WHEEL_get_pending(const WHEEL_T* wheel)
+{
+    return wheel->pending;
+}
+
+// Level is highest tick digit expiry differs from wheel time in, slot is that digit of expiry
+void place(WHEEL_T* wheel, WHEEL_timer_T* timer)
+{
+    CLOCK_ticks_T diff = timer->expires ^ wheel->now;
+    uint32_t level = diff != 0 ? (63u - (uint32_t)__builtin_clzll(diff)) / WHEEL_SLOT_BITS : 0;
+    uint32_t slot = FAR_SLOT;
+
+    if (level < WHEEL_LEVELS)
+    {
+        uint32_t digit = (uint32_t)((timer->expires >> (level * WHEEL_SLOT_BITS)) & SLOT_MASK);
+
+        slot = level * WHEEL_SLOTS + digit;
+        wheel->occupied[level] |= 1ull << digit;
+    }
+
+    WHEEL_timer_T* head = &wheel->slots[slot];
+
+    timer->slot = (uint16_t)slot;
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+void unlink(WHEEL_T* wheel, WHEEL_timer_T* timer)
+{
+    uint32_t slot = timer->slot;
+
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+
+    if (slot != FAR_SLOT && wheel->slots[slot].next == &wheel->slots[slot])
+    {
+        wheel->occupied[slot / WHEEL_SLOTS] &= ~(1ull << (slot & SLOT_MASK));
+    }
+
+    WHEEL_init_timer(timer);
+}
+
+// Re-add timers of slot relative to wheel time, they get to lower level or to expired slot. List
+// is detached first, as far timers may get back to far list.
+void cascade(WHEEL_T* wheel, uint32_t slot)
+{
+    WHEEL_timer_T* head = &wheel->slots[slot];
+    WHEEL_timer_T* timer = head->next;
+
+    if (timer == head) return;
+
+    head->prev->next = NULL;
+    head->next = head;
+    head->prev = head;
+
+    if (slot != FAR_SLOT) wheel->occupied[slot / WHEEL_SLOTS] &= ~(1ull << (slot & SLOT_MASK));
+
+    while (timer != NULL)
+    {
+        WHEEL_timer_T* next = timer->next;
+
+        place(wheel, timer);
+        timer = next;
+    }
+}
+
+bool is_aligned(CLOCK_ticks_T tick, uint32_t bits)
+{
+    return (tick & ((1ull << bits) - 1u)) == 0;
+}
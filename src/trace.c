@@ -0,0 +1,348 @@
+#include "trace.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+// Ring of one thread: written by owner thread only, read by flushing thread only
+typedef struct ring
+{
+    TRACE_record_T records[TRACE_RING_SIZE];
+    uint32_t state; // ring_state_E
+
+    uint8_t pad0[64];
+    uint32_t head; // next record to write, owner thread
+    uint32_t dropped; // records not written as ring was full, reset by flush
+    uint8_t pad1[64];
+    uint32_t tail; // next record to read, flushing thread
+} ring_T;
+
+typedef enum ring_state_ENUM
+{
+    ring_state_FREE,
+    ring_state_OWNED,
+    ring_state_ORPHANED, // owner thread exited, ring is freed by flush when empty
+} ring_state_E;
+
+enum {LINE_SIZE = 512u, SPEC_SIZE = 32u};
+
+static ring_T m_rings[TRACE_MAX_THREADS];
+static uint32_t m_dropped; // records of threads without ring
+static __thread ring_T* m_ring; // ring of calling thread
+
+static pthread_once_t m_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t m_key; // destructor releases ring of exited thread
+
+static pthread_mutex_t m_flush_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// background flushing thread
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t m_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t m_ptid;
+static bool m_running;
+static bool m_stop;
+static uint32_t m_period_ms;
+
+static ring_T* acquire_ring(void);
+static void create_key(void);
+static void release_ring(void* ring);
+static uint64_t now_ns(void);
+static void format_record(const TRACE_record_T* record, char* line, size_t size);
+static size_t format_arg(char* out, size_t size, const char* spec, char conversion, uint64_t arg);
+static void* flusher(void* arg);
+
+void TRACE_write(uint32_t level, const char* fmt, uint32_t args_number, const uint64_t* args)
+{
+    ring_T* ring = m_ring != NULL ? m_ring : acquire_ring();
+
+    if (ring == NULL)
+    {
+        __atomic_fetch_add(&m_dropped, 1u, __ATOMIC_RELAXED);
+        return;
+    }
+
+    uint32_t head = ring->head;
+
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SIZE)
+    {
+        __atomic_fetch_add(&ring->dropped, 1u, __ATOMIC_RELAXED);
+        return;
+    }
+
+    TRACE_record_T* record = &ring->records[head & (TRACE_RING_SIZE - 1u)];
+
+    if (args_number > TRACE_MAX_ARGS) args_number = TRACE_MAX_ARGS;
+
+    record->time_ns = now_ns();
+    record->fmt = fmt;
+    record->level = level;
+    record->args_number = args_number;
+    for (uint32_t i = 0; i < args_number; ++i)
+    {
+        record->args[i] = args[i];
+    }
+
+    __atomic_store_n(&ring->head, head + 1u, __ATOMIC_RELEASE);
+}
+
+uint32_t TRACE_flush(FILE* stream)
+{
+    uint32_t ret = 0;
+    uint32_t heads[TRACE_MAX_THREADS];
+    char line[LINE_SIZE];
+
+    pthread_mutex_lock(&m_flush_lock);
+
+    // records written after this point are left to next flush
+    for (uint32_t i = 0; i < TRACE_MAX_THREADS; ++i)
+    {
+        heads[i] = __atomic_load_n(&m_rings[i].head, __ATOMIC_ACQUIRE);
+    }
+
+    // merge of per thread rings, each of them is in time order already
+    for (;;)
+    {
+        ring_T* next = NULL;
+
+        for (uint32_t i = 0; i < TRACE_MAX_THREADS; ++i)
+        {
+            ring_T* ring = &m_rings[i];
+
+            if (ring->tail == heads[i]) continue;
+
+            const TRACE_record_T* record = &ring->records[ring->tail & (TRACE_RING_SIZE - 1u)];
+
+            if (next == NULL ||
+                record->time_ns < next->records[next->tail & (TRACE_RING_SIZE - 1u)].time_ns)
+            {
+                next = ring;
+            }
+        }
+
+        if (next == NULL) break;
+
+        format_record(&next->records[next->tail & (TRACE_RING_SIZE - 1u)], line, sizeof(line));
+        __atomic_store_n(&next->tail, next->tail + 1u, __ATOMIC_RELEASE);
+
+        fputs(line, stream);
+        fputc('\n', stream);
+        ++ret;
+    }
+
+    uint32_t dropped = __atomic_exchange_n(&m_dropped, 0u, __ATOMIC_RELAXED);
+
+    for (uint32_t i = 0; i < TRACE_MAX_THREADS; ++i)
+    {
+        ring_T* ring = &m_rings[i];
+        uint32_t expected = ring_state_ORPHANED;
+
+        dropped += __atomic_exchange_n(&ring->dropped, 0u, __ATOMIC_RELAXED);
+
+        // owner is gone and all its records are out, ring can be taken by new thread
+        if (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) &&
+            __atomic_load_n(&ring->state, __ATOMIC_ACQUIRE) == ring_state_ORPHANED)
+        {
+            ring->head = ring->tail = 0;
+            __atomic_compare_exchange_n(&ring->state, &expected, ring_state_FREE, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (dropped != 0) fprintf(stream, "TRACE: %u records dropped\n", dropped);
+
+    fflush(stream);
+
+    pthread_mutex_unlock(&m_flush_lock);
+
+    return ret;
+}
+
+bool TRACE_start(uint32_t period_ms)
+{
+    bool ret = false;
+
+    pthread_mutex_lock(&m_lock);
+    if (!m_running)
+    {
+        m_period_ms = period_ms;
+        m_stop = false;
+        m_running = pthread_create(&m_ptid, NULL, flusher, NULL) == 0;
+        ret = m_running;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return ret;
+}
+
+void TRACE_stop(void)
+{
+    pthread_mutex_lock(&m_lock);
+    bool running = m_running;
+    m_stop = true;
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+
+    if (running) pthread_join(m_ptid, NULL);
+
+    pthread_mutex_lock(&m_lock);
+    m_running = false;
+    pthread_mutex_unlock(&m_lock);
+
+    TRACE_flush(stdout);
+}
+
+ring_T* acquire_ring(void)
+{
+    pthread_once(&m_key_once, create_key);
+
+    for (uint32_t i = 0; i < TRACE_MAX_THREADS; ++i)
+    {
+        uint32_t expected = ring_state_FREE;
+
+        if (__atomic_compare_exchange_n(&m_rings[i].state, &expected, ring_state_OWNED, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            m_ring = &m_rings[i];
+            pthread_setspecific(m_key, m_ring);
+
+            return m_ring;
+        }
+    }
+
+    return NULL;
+}
+
+void create_key(void)
+{
+    pthread_key_create(&m_key, release_ring);
+}
+
+void release_ring(void* ring)
+{
+    __atomic_store_n(&((ring_T*)ring)->state, ring_state_ORPHANED, __ATOMIC_RELEASE);
+}
+
+uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// printf of stored arguments: each conversion is formatted separately with argument cast back to
+// type its conversion expects, so any length modifier of original format is handled
+void format_record(const TRACE_record_T* record, char* line, size_t size)
+{
+    const char* f = record->fmt;
+    size_t n = 0;
+    uint32_t arg = 0;
+
+    while (*f != '\0' && n + 1u < size)
+    {
+        if (*f != '%')
+        {
+            line[n++] = *f++;
+            continue;
+        }
+
+        if (f[1] == '%')
+        {
+            line[n++] = '%';
+            f += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion, length is replaced by ll
+        char spec[SPEC_SIZE];
+        size_t s = 0;
+
+        spec[s++] = *f++;
+        while (*f != '\0' && strchr("-+ #0123456789.", *f) != NULL && s < SPEC_SIZE - 4u)
+        {
+            spec[s++] = *f++;
+        }
+        while (*f != '\0' && strchr("hlzjtL", *f) != NULL)
+        {
+            ++f;
+        }
+        if (*f == '\0') break;
+
+        char conversion = *f++;
+        uint64_t value = arg < record->args_number ? record->args[arg] : 0;
+        ++arg;
+
+        spec[s] = '\0';
+        n += format_arg(line + n, size - n, spec, conversion, value);
+        if (n >= size) n = size - 1u;
+    }
+
+    line[n] = '\0';
+}
+
+size_t format_arg(char* out, size_t size, const char* spec, char conversion, uint64_t arg)
+{
+    char full[SPEC_SIZE + 3u];
+    int ret;
+
+    switch (conversion)
+    {
+    case 'd':
+    case 'i':
+        snprintf(full, sizeof(full), "%sll%c", spec, conversion);
+        ret = snprintf(out, size, full, (long long)arg);
+        break;
+
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+        snprintf(full, sizeof(full), "%sll%c", spec, conversion);
+        ret = snprintf(out, size, full, (unsigned long long)arg);
+        break;
+
+    case 'c':
+        snprintf(full, sizeof(full), "%sc", spec);
+        ret = snprintf(out, size, full, (int)arg);
+        break;
+
+    case 's':
+        snprintf(full, sizeof(full), "%ss", spec);
+        ret = snprintf(out, size, full, arg != 0 ? (const char*)(size_t)arg : "(null)");
+        break;
+
+    case 'p':
+        snprintf(full, sizeof(full), "%sp", spec);
+        ret = snprintf(out, size, full, (void*)(size_t)arg);
+        break;
+
+    default: // floating point is not traced
+        ret = snprintf(out, size, "?");
+        break;
+    }
+
+    return ret > 0 ? (size_t)ret : 0;
+}
+
+void* flusher(void* arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&m_lock);
+    while (!m_stop)
+    {
+        pthread_mutex_unlock(&m_lock);
+        TRACE_flush(stdout);
+        pthread_mutex_lock(&m_lock);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)(m_period_ms % 1000u) * 1000000L;
+        deadline.tv_sec += m_period_ms / 1000u + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+
+        if (!m_stop) pthread_cond_timedwait(&m_cond, &m_lock, &deadline);
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return NULL;
+}
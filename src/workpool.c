@@ -0,0 +1,203 @@
+#include "workpool.h"
+
+// participant 0 is calling thread, 1..workers_number are worker threads
+enum {MAX_PARTICIPANTS = MAX_WORKPOOL_WORKERS + 1u};
+
+static void* worker(void* arg);
+static void process(WORKPOOL_T* pool, uint32_t participant);
+static bool take_own(WORKPOOL_T* pool, uint32_t participant, uint32_t* task_index);
+static bool steal(WORKPOOL_T* pool, uint32_t participant, uint32_t* task_index);
+
+bool WORKPOOL_init(WORKPOOL_T* pool, uint32_t workers_number)
+{
+    if (workers_number > MAX_WORKPOOL_WORKERS) return false;
+
+    WORKPOOL_deinit(pool);
+
+    pthread_mutex_lock(&pool->run_lock);
+
+    for (uint32_t i = 0; i < MAX_PARTICIPANTS; ++i)
+    {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->deques[i].front = pool->deques[i].back = 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = false;
+    pool->start_generation = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 0; i < workers_number; ++i)
+    {
+        WORKPOOL_worker_T* w = &pool->workers[i];
+
+        w->pool = pool;
+        w->participant = i + 1u;
+
+        // job would wait for worker which isn't there, so started ones are stopped
+        if (pthread_create(&w->ptid, NULL, worker, w) != 0)
+        {
+            pool->workers_number = i;
+            pthread_mutex_unlock(&pool->run_lock);
+            WORKPOOL_deinit(pool);
+
+            return false;
+        }
+    }
+    pool->workers_number = workers_number;
+
+    pthread_mutex_unlock(&pool->run_lock);
+
+    return true;
+}
+
+void WORKPOOL_deinit(WORKPOOL_T* pool)
+{
+    pthread_mutex_lock(&pool->run_lock);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->job_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 0; i < pool->workers_number; ++i)
+    {
+        pthread_join(pool->workers[i].ptid, NULL);
+    }
+    pool->workers_number = 0;
+
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+uint32_t WORKPOOL_get_workers_number(const WORKPOOL_T* pool)
+{
+    return __atomic_load_n(&pool->workers_number, __ATOMIC_RELAXED);
+}
+
+void WORKPOOL_run(WORKPOOL_T* pool, WORKPOOL_task_T task, void* arg, uint32_t tasks_number)
+{
+    pthread_mutex_lock(&pool->run_lock);
+
+    if (pool->workers_number == 0)
+    {
+        for (uint32_t i = 0; i < tasks_number; ++i)
+        {
+            task(i, arg);
+        }
+
+        pthread_mutex_unlock(&pool->run_lock);
+        return;
+    }
+
+    // split tasks in contiguous ranges, neighbour tasks likely touch neighbour memory
+    uint32_t participants = pool->workers_number + 1u;
+
+    for (uint32_t i = 0; i < participants; ++i)
+    {
+        WORKPOOL_deque_T* d = &pool->deques[i];
+
+        pthread_mutex_lock(&d->lock);
+        d->front = (uint32_t)((unsigned long long)tasks_number * i / participants);
+        d->back = (uint32_t)((unsigned long long)tasks_number * (i + 1u) / participants);
+        pthread_mutex_unlock(&d->lock);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->arg = arg;
+    pool->busy = pool->workers_number;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->job_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    process(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy != 0)
+    {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+void* worker(void* arg)
+{
+    WORKPOOL_worker_T* w = (WORKPOOL_worker_T*)arg;
+    WORKPOOL_T* pool = w->pool;
+    uint32_t generation;
+
+    pthread_mutex_lock(&pool->lock);
+    generation = pool->start_generation;
+
+    for (;;)
+    {
+        while (!pool->stop && generation == pool->generation)
+        {
+            pthread_cond_wait(&pool->job_cond, &pool->lock);
+        }
+
+        if (pool->stop) break;
+
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        process(pool, w->participant);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+void process(WORKPOOL_T* pool, uint32_t participant)
+{
+    uint32_t task_index;
+
+    while (take_own(pool, participant, &task_index) || steal(pool, participant, &task_index))
+    {
+        pool->task(task_index, pool->arg);
+    }
+}
+
+bool take_own(WORKPOOL_T* pool, uint32_t participant, uint32_t* task_index)
+{
+    WORKPOOL_deque_T* d = &pool->deques[participant];
+    bool ret = false;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->front < d->back)
+    {
+        *task_index = d->front++;
+        ret = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return ret;
+}
+
+bool steal(WORKPOOL_T* pool, uint32_t participant, uint32_t* task_index)
+{
+    uint32_t participants = pool->workers_number + 1u;
+
+    for (uint32_t i = 1; i < participants; ++i)
+    {
+        WORKPOOL_deque_T* d = &pool->deques[(participant + i) % participants];
+        bool ret = false;
+
+        pthread_mutex_lock(&d->lock);
+        if (d->front < d->back)
+        {
+            *task_index = --d->back;
+            ret = true;
+        }
+        pthread_mutex_unlock(&d->lock);
+
+        if (ret) return ret;
+    }
+
+    return false;
+}